@@ -3,18 +3,33 @@
 
 #include "capybara/apply.h"
 #include "capybara/array.h"
+#include "capybara/channels.h"
+#include "capybara/chunked.h"
+#include "capybara/codec.h"
+#include "capybara/compressed.h"
+#include "capybara/concat.h"
 #include "capybara/const_int.h"
 #include "capybara/conversion.h"
 #include "capybara/defines.h"
+#include "capybara/eval.h"
 #include "capybara/expr.h"
 #include "capybara/forwards.h"
+#include "capybara/halo.h"
 #include "capybara/indexed.h"
+#include "capybara/layout.h"
 #include "capybara/literals.h"
+#include "capybara/npy.h"
 #include "capybara/nullary.h"
 #include "capybara/ops.h"
+#include "capybara/pad.h"
+#include "capybara/ring.h"
 #include "capybara/select.h"
+#include "capybara/storage.h"
+#include "capybara/stream.h"
+#include "capybara/symmetric.h"
 #include "capybara/util.h"
 #include "capybara/view.h"
+#include "capybara/wrap.h"
 #include "capybara/zip.h"
 
 #endif //CAPYBARA_H
@@ -94,6 +94,10 @@ struct apply_expr: expr<apply_expr<F, Es...>> {
         return operands_;
     }
 
+    std::tuple<Es...>& operands() {
+        return operands_;
+    }
+
   private:
     F function_;
     std::tuple<Es...> operands_;
@@ -119,17 +123,43 @@ struct apply_cursor {
 
     CAPYBARA_INLINE
     void advance(index_t axis, index_t steps) {
-        seq::for_each(operands_, [axis, steps](auto cursor) {
+        seq::for_each(operands_, [axis, steps](auto& cursor) {
             cursor.advance(axis, steps);
         });
     }
 
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        return tuple_segment(operands_, axis, steps);
+    }
+
+    CAPYBARA_INLINE
+    bool has_run(index_t axis) const {
+        return seq::fold(operands_, true, [axis](bool result, const auto& c) {
+            return result
+                && cursor_run<decay_t<decltype(c)>>::available(c, axis);
+        });
+    }
+
+    CAPYBARA_INLINE
+    apply_cursor<F, cursor_run_type<Cs>...> run(index_t axis) const {
+        return run_helper(axis, std::index_sequence_for<Cs...> {});
+    }
+
     CAPYBARA_INLINE
     value_type load() {
         return load_helper(std::index_sequence_for<Cs...> {});
     }
 
   private:
+    template<size_t... Is>
+    CAPYBARA_INLINE apply_cursor<F, cursor_run_type<Cs>...>
+    run_helper(index_t axis, std::index_sequence<Is...>) const {
+        return {
+            function_,
+            cursor_run<Cs>::call(std::get<Is>(operands_), axis)...};
+    }
+
     template<size_t... Is>
     CAPYBARA_INLINE value_type load_helper(std::index_sequence<Is...>) {
         return function_(std::get<Is>(operands_).load()...);
@@ -3,149 +3,12 @@
 #include <sstream>
 
 #include "expr.h"
+#include "layout.h"
+#include "storage.h"
 #include "view.h"
 
 namespace capybara {
 
-namespace storage {
-    template<typename T>
-    struct heap {
-        using value_type = T;
-        using const_value_type = const T;
-
-        heap() = default;
-
-        CAPYBARA_INLINE
-        void resize(size_t n) {
-            data_.reset(new T[n]);
-        }
-
-        CAPYBARA_INLINE
-        T* data() {
-            return data_.get();
-        }
-
-        CAPYBARA_INLINE
-        const T* data() const {
-            return data_.get();
-        }
-
-      private:
-        std::unique_ptr<T[]> data_;
-    };
-
-    template<typename T, size_t Max = 1>
-    struct stack {
-        using value_type = T;
-        using const_value_type = const T;
-
-        stack() = default;
-
-        CAPYBARA_INLINE
-        void resize(size_t n) {
-            if (n > Max) {
-                throw std::runtime_error("exceeds maximum size");
-            }
-        }
-
-        CAPYBARA_INLINE
-        T* data() {
-            return data_.data();
-        }
-
-        CAPYBARA_INLINE
-        const T* data() const {
-            return data_.data();
-        }
-
-      private:
-        std::array<T, Max> data_;
-    };
-
-    template<typename T>
-    struct span {
-        using value_type = T;
-        using const_value_type = T;
-
-        span(stack<T>& v) : data_(v.data()) {}
-        span(heap<T>& v) : data_(v.data()) {}
-        span(T* ptr) : data_(ptr) {}
-
-        void resize(size_t n) {
-            // TODO???
-        }
-
-        CAPYBARA_INLINE
-        T* data() const {
-            return data_;
-        }
-
-      private:
-        T* data_;
-    };
-
-    template<typename T>
-    struct span<const T> {
-        using value_type = const T;
-        using const_value_type = const T;
-
-        span(const stack<T>& v) : data_(v.data()) {}
-        span(const heap<T>& v) : data_(v.data()) {}
-        span(const T* ptr) : data_(ptr) {}
-
-        void resize(size_t n) {
-            // TODO???
-        }
-
-        CAPYBARA_INLINE
-        const T* data() const {
-            return data_;
-        }
-
-      private:
-        T* data_;
-    };
-}  // namespace storage
-
-namespace layout {
-    template<size_t N>
-    struct row_major {
-        static constexpr size_t rank = N;
-        using shape_type = dshape<N>;
-
-        row_major() = default;
-        row_major(shape_type shape) {
-            resize(shape);
-        }
-
-        void resize(shape_type shape) {
-            shape_ = shape;
-        }
-
-        CAPYBARA_INLINE
-        index_t dimension(index_t axis) const {
-            return shape_[axis];
-        }
-
-        CAPYBARA_INLINE
-        stride_t stride(index_t axis) const {
-            stride_t result = 1;
-
-            for (index_t i = axis + 1; i < static_cast<index_t>(rank); i++) {
-                result *= static_cast<stride_t>(shape_[i]);
-            }
-
-            return result;
-        }
-
-      private:
-        shape_type shape_;
-    };
-
-    template<size_t N>
-    using default_layout = row_major<N>;
-}  // namespace layout
-
 template<typename T, size_t N>
 struct array_cursor;
 
@@ -154,7 +17,7 @@ struct expr_traits<array_base<L, S>> {
     static constexpr size_t rank = L::rank;
     using value_type = typename S::value_type;
     static constexpr bool is_writable = !std::is_const<value_type>::value;
-    static constexpr bool is_view = true;
+    static constexpr bool is_view = layout_is_strided<L>::value;
 };
 
 template<typename L, typename S>
@@ -163,8 +26,16 @@ struct expr_traits<const array_base<L, S>>: expr_traits<array_base<L, S>> {
     static constexpr bool is_writable = !std::is_const<value_type>::value;
 };
 
+// Arrays used by reference are referred to through a span. Rvalue arrays
+// are moved into the expression, so that it does not dangle.
 template<typename L, typename S>
 struct expr_nested<array_base<L, S>> {
+    using type =
+        array_base<L, typename storage::expression_storage<S>::type>;
+};
+
+template<typename L, typename S>
+struct expr_nested<array_base<L, S>&> {
     using type = array_base<L, storage::span<typename S::value_type>>;
 };
 
@@ -173,6 +44,20 @@ struct expr_nested<const array_base<L, S>> {
     using type = array_base<L, storage::span<typename S::const_value_type>>;
 };
 
+// Copy-on-write arrays are referred to through their storage, so that
+// reading them never copies the buffer. Only `assign` detaches them.
+template<typename L, typename T, size_t Align>
+struct expr_nested<array_base<L, storage::shared<T, Align>>&> {
+    using type = array_base<L, storage::shared_ref<T, Align>>;
+};
+
+template<typename L, typename T, size_t Align>
+struct expr_prepare_write<array_base<L, storage::shared_ref<T, Align>>> {
+    static void call(const array_base<L, storage::shared_ref<T, Align>>& e) {
+        e.storage().detach();
+    }
+};
+
 template<size_t N>
 void assert_same_shape(dshape<N> lhs, dshape<N> rhs) {
     if (lhs != rhs) {
@@ -182,22 +67,95 @@ void assert_same_shape(dshape<N> lhs, dshape<N> rhs) {
     }
 }
 
+// Strided layouts are traversed with an `array_cursor`. Other layouts
+// specialize `layout_cursor` to provide their own cursor.
+template<typename L, typename T, typename>
+struct layout_cursor {
+    using type = array_cursor<T, L::rank>;
+
+    CAPYBARA_INLINE
+    static type call(const L& layout, T* data) {
+        return type(data, layout.strides());
+    }
+};
+
+/// Offset of element `(0, ..., 0)` from the start of the storage. Zero
+/// unless the layout reserves space in front of it (see `layout::halo`).
+template<typename L, typename = void>
+struct layout_origin {
+    CAPYBARA_INLINE
+    static stride_t call(const L& layout) {
+        return 0;
+    }
+};
+
+template<typename L>
+struct layout_origin<L, void_t<decltype(std::declval<const L&>().origin())>> {
+    CAPYBARA_INLINE
+    static stride_t call(const L& layout) {
+        return layout.origin();
+    }
+};
+
+/// Whether axis 0 is the outermost axis of layout `L`, so that changing its
+/// length leaves the offsets of the existing rows unchanged. Only such
+/// layouts keep their contents on `resize` and support `reserve`, `append`
+/// and `extend`.
+template<typename L>
+struct layout_axis0_outermost: std::false_type {};
+
+template<size_t N>
+struct layout_axis0_outermost<layout::row_major<N>>: std::true_type {};
+
+template<size_t N, size_t Align, size_t Critical>
+struct layout_axis0_outermost<layout::padded<N, Align, Critical>>:
+    std::true_type {};
+
+template<size_t N, size_t W>
+struct layout_axis0_outermost<layout::halo<N, W>>: std::true_type {};
+
+template<size_t N>
+struct layout_axis0_outermost<layout::ring<N>>: std::true_type {};
+
+// Whether the rows of `layout` stay at their offsets when axis 0 grows in
+// place. A ring restarts at slot zero when resized, so that only holds if
+// its oldest row is already there.
+template<typename L, typename = void>
+struct layout_rows_in_place {
+    CAPYBARA_INLINE
+    static bool call(const L& layout) {
+        return true;
+    }
+};
+
+template<typename L>
+struct layout_rows_in_place<
+    L,
+    void_t<decltype(std::declval<const L&>().head())>> {
+    CAPYBARA_INLINE
+    static bool call(const L& layout) {
+        return layout.head() == 0;
+    }
+};
+
 template<typename L, typename S, typename D>
 struct expr_cursor<array_base<L, S>, D> {
-    using type = array_cursor<typename S::value_type, L::rank>;
+    using cursor_type = layout_cursor<L, typename S::value_type>;
+    using type = typename cursor_type::type;
 
     static type call(array_base<L, S>& expr, dshape<L::rank> shape, D device) {
         if (expr.shape() != shape) {
             assert_same_shape(expr.shape(), shape);
         }
 
-        return type(expr.data(), expr.strides());
+        return cursor_type::call(expr.layout(), expr.data());
     }
 };
 
 template<typename L, typename S, typename D>
 struct expr_cursor<const array_base<L, S>, D> {
-    using type = array_cursor<typename S::const_value_type, L::rank>;
+    using cursor_type = layout_cursor<L, typename S::const_value_type>;
+    using type = typename cursor_type::type;
 
     CAPYBARA_INLINE
     static type
@@ -206,7 +164,7 @@ struct expr_cursor<const array_base<L, S>, D> {
             assert_same_shape(expr.shape(), shape);
         }
 
-        return type(expr.data(), expr.strides());
+        return cursor_type::call(expr.layout(), expr.data());
     }
 };
 
@@ -233,20 +191,84 @@ struct array_base: expr<array_base<L, S>> {
         layout_(r.layout_),
         storage_(r.storage_) {}
 
+    template<typename L2, typename S2>
+    array_base(array_base<L2, S2>&& r) :
+        layout_(std::move(r.layout_)),
+        storage_(std::move(r.storage_)) {}
+
     array_base(layout_type layout = {}, storage_type storage = {}) :
         layout_(std::move(layout)),
         storage_(std::move(storage)) {
-        storage_.resize(this->size());
+        storage_.resize(layout_.required_size());
     }
 
     array_base(shape_type shape) {
         resize(shape);
     }
 
+    /// Changes the shape of the array. If the storage supports it (like
+    /// `storage::heap`), the buffer is only replaced when it is too small and
+    /// existing elements keep their offsets. The contents are only kept if
+    /// just axis 0 changes and the layout has it outermost (see
+    /// `layout_axis0_outermost`); in other layouts the elements end up at
+    /// other positions.
     CAPYBARA_INLINE
     void resize(shape_type shape) {
         layout_.resize(shape);
-        storage_.resize(this->size());
+        storage_.resize(layout_.required_size());
+    }
+
+    /// Makes room for `rows` elements along axis 0, so that growing the
+    /// array up to that length does not replace the buffer.
+    void reserve(index_t rows) {
+        static_assert(
+            layout_axis0_outermost<L>::value,
+            "can only reserve rows if axis 0 is outermost");
+        shape_type shape = base_type::shape();
+        shape[0] = rows;
+        storage_.reserve(resized_layout(shape).required_size());
+    }
+
+    /// Appends `row`, which has the shape of axes `1..N`, at the end of axis
+    /// 0. Capacity grows geometrically, so appending is amortized O(1) per
+    /// element. Requires a layout with axis 0 outermost.
+    template<typename E>
+    void append(E&& row) {
+        static_assert(rank > 0, "cannot append to array without axes");
+        static_assert(
+            layout_axis0_outermost<L>::value,
+            "can only append rows if axis 0 is outermost");
+        auto source = into_expr<rank - 1>(std::forward<E>(row));
+
+        for (size_t i = 1; i < rank; i++) {
+            index_t n = source.dimension(i - 1);
+
+            if (n != 1 && n != layout_.dimension(i)) {
+                throw std::runtime_error("cannot append row of other shape");
+            }
+        }
+
+        grow_assign(1, std::move(source));
+    }
+
+    /// Appends the rows of `rows` at the end of axis 0, see `append`.
+    template<typename E>
+    void extend(E&& rows) {
+        static_assert(rank > 0, "cannot extend array without axes");
+        static_assert(
+            layout_axis0_outermost<L>::value,
+            "can only extend rows if axis 0 is outermost");
+        auto source = into_expr<rank>(std::forward<E>(rows));
+
+        for (size_t i = 1; i < rank; i++) {
+            index_t n = source.dimension(i);
+
+            if (n != 1 && n != layout_.dimension(i)) {
+                throw std::runtime_error("cannot extend with other shape");
+            }
+        }
+
+        grow_assign(source.dimension(0), std::move(source));
     }
 
     CAPYBARA_INLINE
@@ -259,17 +281,109 @@ struct array_base: expr<array_base<L, S>> {
         return layout_.stride(axis);
     }
 
+    CAPYBARA_INLINE
+    layout_type& layout() {
+        return layout_;
+    }
+
+    CAPYBARA_INLINE
+    const layout_type& layout() const {
+        return layout_;
+    }
+
+    CAPYBARA_INLINE
+    storage_type& storage() {
+        return storage_;
+    }
+
+    CAPYBARA_INLINE
+    const storage_type& storage() const {
+        return storage_;
+    }
+
     CAPYBARA_INLINE
     value_type* data() {
-        return storage_.data();
+        return storage_.data() + layout_origin<L>::call(layout_);
     }
 
     CAPYBARA_INLINE
     const_value_type* data() const {
-        return storage_.data();
+        return storage_.data() + layout_origin<L>::call(layout_);
     }
 
   private:
+    // Adds `count` rows along axis 0 and writes `source` into them. If that
+    // moves the existing rows, `source` may still read from their old place
+    // (as in `a.extend(a)`), so it is evaluated into a temporary first. Like
+    // other temporaries, it comes from the current memory resource of the
+    // thread.
+    template<typename E>
+    void grow_assign(index_t count, E&& source) {
+        if (grow_moves_rows(count)) {
+            using temporary_type = array_base<
+                layout::default_layout<expr_rank<E>>,
+                storage::arena<value_type>>;
+
+            temporary_type temporary(source.shape());
+            assign(temporary, std::forward<E>(source));
+            assign(grow(count), std::move(temporary));
+        } else {
+            assign(grow(count), std::forward<E>(source));
+        }
+    }
+
+    L resized_layout(shape_type shape) const {
+        L result = layout_;
+        result.resize(shape);
+        return result;
+    }
+
+    bool grow_moves_rows(index_t count) const {
+        shape_type shape = base_type::shape();
+        shape[0] += count;
+
+        return resized_layout(shape).required_size() > storage_.capacity()
+            || !layout_rows_in_place<L>::call(layout_);
+    }
+
+    // Adds `count` rows along axis 0 and returns a view of them. The rows are
+    // added in place if the layout allows it, otherwise the array is laid
+    // out again in a new buffer.
+    auto grow(index_t count) {
+        shape_type shape = base_type::shape();
+        index_t begin = shape[0];
+        shape[0] += count;
+
+        size_t needed = resized_layout(shape).required_size();
+        size_t capacity = storage_.capacity();
+        size_t reserved = needed > 2 * capacity ? needed : 2 * capacity;
+
+        if (!layout_rows_in_place<L>::call(layout_)) {
+            array_base result;
+            result.storage_.reserve(reserved);
+            result.resize(shape);
+
+            assign(
+                make_view(
+                    view::slice_axis<rank, index_t>(0, 0, begin),
+                    result),
+                *this);
+
+            layout_ = std::move(result.layout_);
+            storage_ = std::move(result.storage_);
+        } else {
+            if (needed > capacity) {
+                storage_.reserve(reserved);
+            }
+
+            resize(shape);
+        }
+
+        return make_view(
+            view::slice_axis<rank, index_t>(0, begin, count),
+            *this);
+    }
+
     L layout_;
     S storage_;
 };
@@ -279,11 +393,22 @@ template<typename T, size_t N, typename V>
 struct apply_view_cursor<V, array_cursor<T, N>> {
     using type = array_cursor<T, V::rank_output>;
 
-    //
+    // Views over arrays are folded into the strides of the cursor.
     static type call(V view, array_cursor<T, N> cursor) {
-        throw std::runtime_error("oh no");
-    }
+        typename type::strides_type strides;
+
+        for (index_t i = 0; i < index_t(V::rank_output); i++) {
+            stride_t result = 0;
 
+            view.advance(i, [&](auto new_axis, auto new_steps) {
+                result += cursor.stride(new_axis) * new_steps;
+            });
+
+            strides[i] = result;
+        }
+
+        return type(cursor.data(), strides);
+    }
 };
 
 template<typename T, size_t N>
@@ -299,6 +424,16 @@ struct array_cursor {
         data_ += strides_[axis] * steps;
     }
 
+    CAPYBARA_INLINE
+    T* data() const {
+        return data_;
+    }
+
+    CAPYBARA_INLINE
+    stride_t stride(index_t axis) const {
+        return strides_[axis];
+    }
+
     T load() const {
         return *data_;
     }
@@ -325,6 +460,16 @@ struct array_cursor<const T, N> {
         data_ += strides_[axis] * steps;
     }
 
+    CAPYBARA_INLINE
+    const T* data() const {
+        return data_;
+    }
+
+    CAPYBARA_INLINE
+    stride_t stride(index_t axis) const {
+        return strides_[axis];
+    }
+
     T load() const {
         return *data_;
     }
@@ -340,6 +485,9 @@ using array = array_base<layout::default_layout<N>, storage::heap<T>>;
 template<typename T, size_t N>
 using array_ref = array_base<layout::default_layout<N>, storage::span<T>>;
 
+template<typename T, size_t N>
+using strided_array_ref = array_base<layout::strided<N>, storage::span<T>>;
+
 template<typename T>
 using array0 = array<T, 0>;
 template<typename T>
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "array.h"
+#include "layout.h"
+
+namespace capybara {
+
+template<size_t N, size_t C, typename S>
+using interleaved_array_type = array_base<layout::interleaved<N, C>, S>;
+
+template<typename T, size_t N, size_t C>
+using channel_array_ref =
+    array_base<layout::channel_plane<N, C>, storage::span<T>>;
+
+/// Returns channel `c` of an interleaved `image` as an array over the pixel
+/// axes. The channel is not copied: expressions over it read and write the
+/// interleaved buffer directly.
+template<size_t N, size_t C, typename S>
+channel_array_ref<typename S::value_type, N - 1, C>
+channel(interleaved_array_type<N, C, S>& image, index_t c) {
+    using layout_type = layout::channel_plane<N - 1, C>;
+    using storage_type = storage::span<typename S::value_type>;
+    dshape<N - 1> shape;
+
+    if (c < 0 || c >= index_t(C)) {
+        throw std::runtime_error("channel out of bounds");
+    }
+
+    for (size_t i = 0; i + 1 < N; i++) {
+        shape[i] = image.dimension(i);
+    }
+
+    return {layout_type(shape), storage_type(image.data() + c)};
+}
+
+template<size_t N, size_t C, typename S>
+channel_array_ref<typename S::const_value_type, N - 1, C>
+channel(const interleaved_array_type<N, C, S>& image, index_t c) {
+    using layout_type = layout::channel_plane<N - 1, C>;
+    using storage_type = storage::span<typename S::const_value_type>;
+    dshape<N - 1> shape;
+
+    if (c < 0 || c >= index_t(C)) {
+        throw std::runtime_error("channel out of bounds");
+    }
+
+    for (size_t i = 0; i + 1 < N; i++) {
+        shape[i] = image.dimension(i);
+    }
+
+    return {layout_type(shape), storage_type(image.data() + c)};
+}
+
+// Both loops visit every pixel once and move all `C` channels at a time.
+// Since `C` is known at compile time, the inner loop is unrolled and the
+// compiler turns the pair into vectorized (de)interleaving loads/stores.
+template<size_t C, typename T, typename U>
+CAPYBARA_INLINE void deinterleave_pixels(
+    const T* CAPYBARA_RESTRICT src,
+    U* CAPYBARA_RESTRICT dst,
+    index_t pixels) {
+    for (index_t p = 0; p < pixels; p++) {
+        for (size_t c = 0; c < C; c++) {
+            dst[index_t(c) * pixels + p] = src[p * index_t(C) + index_t(c)];
+        }
+    }
+}
+
+template<size_t C, typename T, typename U>
+CAPYBARA_INLINE void interleave_pixels(
+    const T* CAPYBARA_RESTRICT src,
+    U* CAPYBARA_RESTRICT dst,
+    index_t pixels) {
+    for (index_t p = 0; p < pixels; p++) {
+        for (size_t c = 0; c < C; c++) {
+            dst[p * index_t(C) + index_t(c)] = src[index_t(c) * pixels + p];
+        }
+    }
+}
+
+/// Splits an interleaved `image` of shape `(..., C)` into a planar array of
+/// shape `(C, ...)` in a single pass.
+template<size_t N, size_t C, typename S>
+array<typename std::remove_const<typename S::value_type>::type, N>
+deinterleave(const interleaved_array_type<N, C, S>& image) {
+    using T = typename std::remove_const<typename S::value_type>::type;
+    dshape<N> shape;
+    index_t pixels = 1;
+
+    shape[0] = index_t(C);
+    for (size_t i = 0; i + 1 < N; i++) {
+        shape[i + 1] = image.dimension(i);
+        pixels *= image.dimension(i);
+    }
+
+    array<T, N> result(shape);
+    deinterleave_pixels<C>(image.data(), result.data(), pixels);
+    return result;
+}
+
+/// Merges a planar array of shape `(C, ...)` into an interleaved image of
+/// shape `(..., C)` in a single pass.
+template<size_t C, size_t N, typename S>
+interleaved_array_type<
+    N,
+    C,
+    storage::heap<typename std::remove_const<typename S::value_type>::type>>
+interleave(const array_base<layout::row_major<N>, S>& planes) {
+    using T = typename std::remove_const<typename S::value_type>::type;
+    dshape<N> shape;
+    index_t pixels = 1;
+
+    if (planes.dimension(0) != index_t(C)) {
+        throw std::runtime_error("first axis must match channels");
+    }
+
+    shape[N - 1] = index_t(C);
+    for (size_t i = 0; i + 1 < N; i++) {
+        shape[i] = planes.dimension(i + 1);
+        pixels *= planes.dimension(i + 1);
+    }
+
+    interleaved_array_type<N, C, storage::heap<T>> result(shape);
+    interleave_pixels<C>(planes.data(), result.data(), pixels);
+    return result;
+}
+
+}  // namespace capybara
@@ -0,0 +1,760 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "array.h"
+#include "codec.h"
+#include "eval.h"
+#include "layout.h"
+#include "npy.h"
+#include "storage.h"
+
+namespace capybara {
+
+namespace chunked {
+    static constexpr char magic[] = "CAPYCHNK";
+    static constexpr size_t magic_size = 8;
+    static constexpr uint8_t version = 1;
+
+    // Size of the fixed part of the header and of one chunk index entry.
+    static constexpr size_t header_size = 16;
+    static constexpr size_t entry_size = 16;
+
+    /// File accessed at explicit offsets, so that several threads can read
+    /// and write it at once.
+    struct file {
+        file(const std::string& path, bool writable, bool create) {
+#if defined(CAPYBARA_POSIX_MMAP)
+            int flags = writable ? O_RDWR : O_RDONLY;
+            flags |= create ? O_CREAT | O_TRUNC : 0;
+            fd_ = ::open(path.c_str(), flags, 0644);
+
+            if (fd_ < 0) {
+                throw std::runtime_error("cannot open file: " + path);
+            }
+#else
+            auto mode = std::ios::binary | std::ios::in;
+            mode |= writable ? std::ios::out : std::ios::openmode {};
+            mode |= create ? std::ios::trunc : std::ios::openmode {};
+            stream_.open(path, mode);
+
+            if (!stream_) {
+                throw std::runtime_error("cannot open file: " + path);
+            }
+#endif
+        }
+
+        file(const file&) = delete;
+        file& operator=(const file&) = delete;
+
+        ~file() {
+#if defined(CAPYBARA_POSIX_MMAP)
+            ::close(fd_);
+#endif
+        }
+
+        void read(char* dst, size_t n, uint64_t offset) const {
+#if defined(CAPYBARA_POSIX_MMAP)
+            while (n > 0) {
+                ssize_t k = ::pread(fd_, dst, n, static_cast<off_t>(offset));
+
+                if (k < 0 && errno == EINTR) {
+                    continue;
+                } else if (k <= 0) {
+                    throw std::runtime_error("cannot read chunked file");
+                }
+
+                dst += k;
+                n -= size_t(k);
+                offset += uint64_t(k);
+            }
+#else
+            std::lock_guard<std::mutex> guard(mutex_);
+            stream_.seekg(static_cast<std::streamoff>(offset));
+            stream_.read(dst, static_cast<std::streamsize>(n));
+
+            if (!stream_) {
+                throw std::runtime_error("cannot read chunked file");
+            }
+#endif
+        }
+
+        void write(const char* src, size_t n, uint64_t offset) {
+#if defined(CAPYBARA_POSIX_MMAP)
+            while (n > 0) {
+                ssize_t k = ::pwrite(fd_, src, n, static_cast<off_t>(offset));
+
+                if (k < 0 && errno == EINTR) {
+                    continue;
+                } else if (k <= 0) {
+                    throw std::runtime_error("cannot write chunked file");
+                }
+
+                src += k;
+                n -= size_t(k);
+                offset += uint64_t(k);
+            }
+#else
+            std::lock_guard<std::mutex> guard(mutex_);
+            stream_.seekp(static_cast<std::streamoff>(offset));
+            stream_.write(src, static_cast<std::streamsize>(n));
+
+            if (!stream_) {
+                throw std::runtime_error("cannot write chunked file");
+            }
+#endif
+        }
+
+        uint64_t size() const {
+#if defined(CAPYBARA_POSIX_MMAP)
+            struct stat info;
+            if (::fstat(fd_, &info) != 0) {
+                throw std::runtime_error("cannot stat chunked file");
+            }
+
+            return static_cast<uint64_t>(info.st_size);
+#else
+            std::lock_guard<std::mutex> guard(mutex_);
+            stream_.seekg(0, std::ios::end);
+            return static_cast<uint64_t>(stream_.tellg());
+#endif
+        }
+
+        void flush() {
+#if defined(CAPYBARA_POSIX_MMAP)
+            if (::fsync(fd_) != 0) {
+                throw std::runtime_error("cannot flush chunked file");
+            }
+#else
+            std::lock_guard<std::mutex> guard(mutex_);
+            stream_.flush();
+#endif
+        }
+
+      private:
+#if defined(CAPYBARA_POSIX_MMAP)
+        int fd_ = -1;
+#else
+        mutable std::mutex mutex_;
+        mutable std::fstream stream_;
+#endif
+    };
+
+    // Position `i`, in row-major order, within a block of shape `extent`.
+    template<size_t N>
+    dshape<N> unravel(index_t i, const dshape<N>& extent) {
+        dshape<N> index;
+
+        for (size_t k = N; k > 0; k--) {
+            index[k - 1] = i % extent[k - 1];
+            i /= extent[k - 1];
+        }
+
+        return index;
+    }
+
+    // View of the block of `array` at `offset` with shape `extent`.
+    template<typename T, size_t N>
+    strided_array_ref<T, N>
+    region(array<T, N>& array, dshape<N> offset, dshape<N> extent) {
+        T* data = array.data();
+
+        for (size_t i = 0; i < N; i++) {
+            data += offset[i] * array.stride(i);
+        }
+
+        return {
+            layout::strided<N>(extent, array.strides()),
+            storage::span<T>(data)};
+    }
+}  // namespace chunked
+
+/// Array stored on disk as a grid of chunks of a fixed shape, each of which
+/// may be compressed (see `chunk_codec`). Chunks are read and written one
+/// at a time, so an array larger than memory can be processed chunk by
+/// chunk, and the bulk operations handle several chunks in parallel with
+/// one buffer per thread. Chunks that were never written read as zero.
+///
+/// A compressed chunk that grows when it is rewritten moves to a new place,
+/// and one that shrinks leaves part of its old place unused. Such gaps are
+/// reused by later writes (also after the file is reopened), but the file
+/// itself never shrinks.
+///
+/// The file holds a header with the dtype, shape and chunk shape, then the
+/// offset and size of every chunk in row-major order, then the chunk data
+/// in native byte order.
+template<typename T, size_t N>
+struct chunked_file {
+    static_assert(N > 0, "chunked file must have at least one axis");
+    static_assert(
+        std::is_arithmetic<T>::value,
+        "only arithmetic types can be stored in chunked files");
+
+    using value_type = T;
+    using shape_type = dshape<N>;
+    using chunk_type = array<T, N>;
+
+    /// Creates the file `path` for an array of `shape`, replacing any file
+    /// that exists. All chunks initially read as zero. Throws if `codec`
+    /// cannot compress `T` (see `codec::supports`).
+    static chunked_file create(
+        const std::string& path,
+        shape_type shape,
+        shape_type chunk_shape,
+        chunk_codec codec = chunk_codec::none) {
+        for (size_t i = 0; i < N; i++) {
+            if (shape[i] < 0 || chunk_shape[i] <= 0) {
+                throw std::runtime_error("invalid shape for chunked file");
+            }
+        }
+
+        if (!codec::supports<T>(codec)) {
+            throw std::runtime_error("codec does not support this dtype");
+        }
+
+        chunked_file result(path, true, true);
+        result.init(shape, chunk_shape, codec);
+        result.index_.assign(size_t(result.chunk_count()), entry {0, 0});
+
+        std::string header(chunked::magic, chunked::magic_size);
+        header += static_cast<char>(chunked::version);
+        header += npy::native_byte_order();
+        header += npy::kind<T>();
+        header += static_cast<char>(sizeof(T));
+        header += static_cast<char>(codec);
+        header += static_cast<char>(N);
+        header.append(2, '\0');
+
+        for (size_t i = 0; i < N; i++) {
+            npy::write_le(header, uint64_t(shape[i]), 8);
+        }
+
+        for (size_t i = 0; i < N; i++) {
+            npy::write_le(header, uint64_t(chunk_shape[i]), 8);
+        }
+
+        header.append(result.index_.size() * chunked::entry_size, '\0');
+        result.file_->write(header.data(), header.size(), 0);
+        result.end_ = header.size();
+        return result;
+    }
+
+    /// Opens the existing file `path`, read-only unless `writable`.
+    static chunked_file open(const std::string& path, bool writable = false) {
+        chunked_file result(path, writable, false);
+        char header[chunked::header_size];
+        result.file_->read(header, sizeof(header), 0);
+
+        if (std::memcmp(header, chunked::magic, chunked::magic_size) != 0
+            || header[8] != static_cast<char>(chunked::version)) {
+            throw std::runtime_error("not a chunked file: " + path);
+        }
+
+        if (header[9] != npy::native_byte_order()
+            || header[10] != npy::kind<T>()
+            || header[11] != static_cast<char>(sizeof(T))) {
+            throw std::runtime_error("chunked file has other dtype");
+        }
+
+        if (header[13] != static_cast<char>(N)) {
+            throw std::runtime_error("chunked file has other rank");
+        }
+
+        if (static_cast<unsigned char>(header[12])
+            > static_cast<unsigned char>(chunk_codec::delta_bitpack)) {
+            throw std::runtime_error("chunked file has unknown codec");
+        }
+
+        if (!codec::supports<T>(static_cast<chunk_codec>(header[12]))) {
+            throw std::runtime_error("chunked file has codec for other dtype");
+        }
+
+        std::vector<char> shapes(2 * N * 8);
+        result.file_->read(shapes.data(), shapes.size(), chunked::header_size);
+        shape_type shape;
+        shape_type chunk_shape;
+
+        for (size_t i = 0; i < N; i++) {
+            shape[i] = index_t(npy::read_le(&shapes[i * 8], 8));
+            chunk_shape[i] = index_t(npy::read_le(&shapes[(N + i) * 8], 8));
+
+            if (shape[i] < 0 || chunk_shape[i] <= 0) {
+                throw std::runtime_error("corrupt chunked file: " + path);
+            }
+        }
+
+        result.init(shape, chunk_shape, static_cast<chunk_codec>(header[12]));
+
+        std::vector<char> entries(
+            size_t(result.chunk_count()) * chunked::entry_size);
+        result.file_->read(entries.data(), entries.size(), result.index_at(0));
+
+        for (size_t i = 0; i < entries.size(); i += chunked::entry_size) {
+            result.index_.push_back(entry {
+                npy::read_le(&entries[i], 8),
+                npy::read_le(&entries[i + 8], 8)});
+        }
+
+        result.find_gaps();
+        return result;
+    }
+
+    shape_type shape() const {
+        return shape_;
+    }
+
+    shape_type chunk_shape() const {
+        return chunk_shape_;
+    }
+
+    /// Number of chunks along every axis.
+    shape_type grid() const {
+        return grid_;
+    }
+
+    index_t chunk_count() const {
+        index_t count = 1;
+        for (size_t i = 0; i < N; i++) {
+            count *= grid_[i];
+        }
+
+        return count;
+    }
+
+    chunk_codec codec() const {
+        return codec_;
+    }
+
+    /// Position in the array of the first element of chunk `chunk`.
+    shape_type chunk_begin(shape_type chunk) const {
+        shape_type result;
+        for (size_t i = 0; i < N; i++) {
+            result[i] = chunk[i] * chunk_shape_[i];
+        }
+
+        return result;
+    }
+
+    /// Shape of chunk `chunk`. Chunks at the far edge of an axis are cut
+    /// off at the end of the array.
+    shape_type chunk_extent(shape_type chunk) const {
+        shape_type result;
+        for (size_t i = 0; i < N; i++) {
+            index_t rest = shape_[i] - chunk[i] * chunk_shape_[i];
+            result[i] = rest < chunk_shape_[i] ? rest : chunk_shape_[i];
+        }
+
+        return result;
+    }
+
+    /// Reads chunk `chunk` into `out`, which is resized to its extent. Pass
+    /// the same `out` for several chunks to avoid allocating every time.
+    void read_chunk(shape_type chunk, chunk_type& out) const {
+        index_t id = chunk_id(chunk);
+        out.resize(chunk_extent(chunk));
+
+        T* data = out.data();
+        size_t count = out.size();
+        entry e = lookup(id);
+
+        if (e.offset == 0) {
+            std::fill(data, data + count, T {});
+        } else if (codec_ == chunk_codec::none) {
+            if (e.size != count * sizeof(T)) {
+                throw std::runtime_error("corrupt chunk in chunked file");
+            }
+
+            file_->read(reinterpret_cast<char*>(data), e.size, e.offset);
+        } else {
+            std::vector<char> buffer(e.size);
+            file_->read(buffer.data(), buffer.size(), e.offset);
+            codec::decode(codec_, buffer.data(), buffer.size(), data, count);
+        }
+    }
+
+    chunk_type read_chunk(shape_type chunk) const {
+        chunk_type result;
+        read_chunk(chunk, result);
+        return result;
+    }
+
+    /// Writes `expr`, which has the extent of chunk `chunk`, to the file.
+    /// Different chunks may be written from different threads at once, but
+    /// a chunk must not be read while it is being written.
+    template<typename E>
+    void write_chunk(shape_type chunk, const E& expr) {
+        chunk_type buffer(chunk_extent(chunk));
+        assign(buffer, expr);
+        store_chunk(chunk_id(chunk), buffer);
+    }
+
+    /// Calls `fun(chunk, data)` for every chunk, with its grid position and
+    /// contents, on up to `threads` threads. Every thread reuses a single
+    /// buffer, so at most `threads` chunks are held in memory at once.
+    template<typename F>
+    void for_each_chunk(F fun, size_t threads = 1) const {
+        std::vector<chunk_type> buffers(threads > 0 ? threads : 1);
+
+        parallel_for(
+            chunk_count(),
+            buffers.size(),
+            [&](size_t worker, index_t i) {
+                shape_type chunk = chunked::unravel(i, grid_);
+                read_chunk(chunk, buffers[worker]);
+                fun(static_cast<const shape_type&>(chunk), buffers[worker]);
+            });
+    }
+
+    /// Reads the block of shape `extent` that starts at `begin`. The chunks
+    /// that overlap the block are read on up to `threads` threads.
+    chunk_type
+    read(shape_type begin, shape_type extent, size_t threads = 1) const {
+        chunk_type result;
+        read(begin, extent, result, threads);
+        return result;
+    }
+
+    /// Reads the block of shape `extent` that starts at `begin` into
+    /// `result`, which is resized to `extent`, see `read`.
+    void read(
+        shape_type begin,
+        shape_type extent,
+        chunk_type& result,
+        size_t threads = 1) const {
+        shape_type first;
+        shape_type count;
+        index_t total = overlap(begin, extent, first, count);
+        std::vector<chunk_type> buffers(threads > 0 ? threads : 1);
+        result.resize(extent);
+
+        parallel_for(
+            total,
+            buffers.size(),
+            [&](size_t worker, index_t i) {
+                chunk_type& buffer = buffers[worker];
+                shape_type chunk = chunked::unravel(i, count);
+                shape_type lo;
+                shape_type hi;
+
+                for (size_t k = 0; k < N; k++) {
+                    chunk[k] += first[k];
+                }
+
+                read_chunk(chunk, buffer);
+                intersect(chunk, begin, extent, lo, hi);
+                shape_type start = chunk_begin(chunk);
+
+                assign(
+                    chunked::region(result, sub(lo, begin), sub(hi, lo)),
+                    chunked::region(buffer, sub(lo, start), sub(hi, lo)));
+            });
+    }
+
+    /// Reads the whole array, see `read`.
+    chunk_type read(size_t threads = 1) const {
+        return read(shape_type {}, shape_, threads);
+    }
+
+    /// Writes `expr` into the block of the array that starts at `begin`,
+    /// on up to `threads` threads. Only the part of `expr` that covers one
+    /// chunk is evaluated at a time. Chunks that are partly covered are read
+    /// and written back with the new values. Repeated partial writes to
+    /// compressed chunks do not grow the file without bound, since the space
+    /// that rewritten chunks leave behind is reused.
+    template<typename E>
+    void write(const E& expr, shape_type begin = {}, size_t threads = 1) {
+        const auto source = into_expr<N>(expr);
+        shape_type extent = source.shape();
+        shape_type first;
+        shape_type count;
+        index_t total = overlap(begin, extent, first, count);
+        std::vector<chunk_type> buffers(threads > 0 ? threads : 1);
+
+        parallel_for(
+            total,
+            buffers.size(),
+            [&](size_t worker, index_t i) {
+                chunk_type& buffer = buffers[worker];
+                shape_type chunk = chunked::unravel(i, count);
+                shape_type lo;
+                shape_type hi;
+
+                for (size_t k = 0; k < N; k++) {
+                    chunk[k] += first[k];
+                }
+
+                shape_type start = chunk_begin(chunk);
+                bool covered = intersect(chunk, begin, extent, lo, hi);
+
+                if (covered) {
+                    buffer.resize(chunk_extent(chunk));
+                } else {
+                    read_chunk(chunk, buffer);
+                }
+
+                assign_region(
+                    chunked::region(buffer, sub(lo, start), sub(hi, lo)),
+                    source,
+                    extent,
+                    sub(lo, begin));
+
+                store_chunk(chunk_id(chunk), buffer);
+            });
+    }
+
+    /// Writes `expr` over the whole array, see `write`.
+    template<typename E>
+    void write(const E& expr, size_t threads) {
+        write(expr, shape_type {}, threads);
+    }
+
+    /// Waits until all written chunks have reached the disk.
+    void flush() {
+        file_->flush();
+    }
+
+  private:
+    struct entry {
+        uint64_t offset;  // zero if the chunk was never written
+        uint64_t size;
+    };
+
+    chunked_file(const std::string& path, bool writable, bool create) :
+        file_(new chunked::file(path, writable, create)),
+        mutex_(new std::mutex),
+        writable_(writable) {}
+
+    void init(shape_type shape, shape_type chunk_shape, chunk_codec codec) {
+        shape_ = shape;
+        chunk_shape_ = chunk_shape;
+        codec_ = codec;
+
+        for (size_t i = 0; i < N; i++) {
+            grid_[i] = (shape[i] + chunk_shape[i] - 1) / chunk_shape[i];
+        }
+    }
+
+    uint64_t index_at(index_t id) const {
+        return chunked::header_size + 2 * N * 8
+            + uint64_t(id) * chunked::entry_size;
+    }
+
+    index_t chunk_id(shape_type chunk) const {
+        index_t id = 0;
+
+        for (size_t i = 0; i < N; i++) {
+            if (chunk[i] < 0 || chunk[i] >= grid_[i]) {
+                throw std::runtime_error("chunk index out of bounds");
+            }
+
+            id = id * grid_[i] + chunk[i];
+        }
+
+        return id;
+    }
+
+    entry lookup(index_t id) const {
+        std::lock_guard<std::mutex> guard(*mutex_);
+        return index_[size_t(id)];
+    }
+
+    static shape_type sub(shape_type a, shape_type b) {
+        for (size_t i = 0; i < N; i++) {
+            a[i] -= b[i];
+        }
+
+        return a;
+    }
+
+    // Finds the chunks that overlap the block at `begin` with shape
+    // `extent`: `count` chunks along each axis starting at `first`.
+    index_t overlap(
+        shape_type begin,
+        shape_type extent,
+        shape_type& first,
+        shape_type& count) const {
+        index_t total = 1;
+
+        for (size_t i = 0; i < N; i++) {
+            if (begin[i] < 0 || extent[i] < 0
+                || begin[i] + extent[i] > shape_[i]) {
+                throw std::runtime_error("region out of bounds");
+            }
+
+            index_t end = begin[i] + extent[i];
+            first[i] = begin[i] / chunk_shape_[i];
+            count[i] = extent[i] > 0
+                ? (end + chunk_shape_[i] - 1) / chunk_shape_[i] - first[i]
+                : 0;
+            total *= count[i];
+        }
+
+        return total;
+    }
+
+    // Computes the part `lo..hi` of chunk `chunk` that lies inside the
+    // block at `begin` with shape `extent`. Returns whether that is all of
+    // the chunk.
+    bool intersect(
+        shape_type chunk,
+        shape_type begin,
+        shape_type extent,
+        shape_type& lo,
+        shape_type& hi) const {
+        shape_type start = chunk_begin(chunk);
+        shape_type size = chunk_extent(chunk);
+        bool covered = true;
+
+        for (size_t i = 0; i < N; i++) {
+            index_t end = begin[i] + extent[i];
+            lo[i] = start[i] > begin[i] ? start[i] : begin[i];
+            hi[i] = start[i] + size[i] < end ? start[i] + size[i] : end;
+            covered &= lo[i] == start[i] && hi[i] == start[i] + size[i];
+        }
+
+        return covered;
+    }
+
+    void store_chunk(index_t id, const chunk_type& buffer) {
+        if (!writable_) {
+            throw std::runtime_error("chunked file is read-only");
+        }
+
+        const char* data = reinterpret_cast<const char*>(buffer.data());
+        size_t bytes = buffer.size() * sizeof(T);
+        std::vector<char> encoded;
+
+        if (codec_ != chunk_codec::none) {
+            codec::encode(codec_, buffer.data(), buffer.size(), encoded);
+            data = encoded.data();
+            bytes = encoded.size();
+        }
+
+        // Data that no longer fits its old place is written elsewhere
+        entry old = lookup(id);
+        entry e {old.offset, bytes};
+        if (old.offset == 0 || bytes > old.size) {
+            std::lock_guard<std::mutex> guard(*mutex_);
+            e.offset = allocate(bytes);
+        }
+
+        file_->write(data, bytes, e.offset);
+
+        // The index is updated after the data is written, so that it never
+        // points at data that is not there yet.
+        std::string record;
+        npy::write_le(record, e.offset, 8);
+        npy::write_le(record, e.size, 8);
+        file_->write(record.data(), record.size(), index_at(id));
+
+        // Likewise, the old place is only handed out again once the index
+        // no longer points at it.
+        std::lock_guard<std::mutex> guard(*mutex_);
+        index_[size_t(id)] = e;
+
+        if (old.offset != 0 && old.offset != e.offset) {
+            release(old.offset, old.size);
+        } else if (old.offset != 0) {
+            release(old.offset + e.size, old.size - e.size);
+        }
+    }
+
+    // Returns the offset of `bytes` bytes of unused space: the first gap
+    // that is large enough, or else the end of the data. Called with
+    // `mutex_` held.
+    uint64_t allocate(uint64_t bytes) {
+        for (auto it = gaps_.begin(); it != gaps_.end(); ++it) {
+            if (it->second >= bytes) {
+                uint64_t offset = it->first;
+                uint64_t rest = it->second - bytes;
+                gaps_.erase(it);
+
+                if (rest > 0) {
+                    gaps_[offset + bytes] = rest;
+                }
+
+                return offset;
+            }
+        }
+
+        uint64_t offset = end_;
+        end_ += bytes;
+        return offset;
+    }
+
+    // Marks `bytes` bytes at `offset` as unused, merged with adjacent gaps.
+    // Called with `mutex_` held.
+    void release(uint64_t offset, uint64_t bytes) {
+        if (bytes == 0) {
+            return;
+        }
+
+        auto next = gaps_.lower_bound(offset);
+        if (next != gaps_.end() && offset + bytes == next->first) {
+            bytes += next->second;
+            next = gaps_.erase(next);
+        }
+
+        if (next != gaps_.begin()) {
+            auto prev = std::prev(next);
+
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                bytes += prev->second;
+                gaps_.erase(prev);
+            }
+        }
+
+        if (offset + bytes == end_) {
+            end_ = offset;
+        } else {
+            gaps_[offset] = bytes;
+        }
+    }
+
+    // Rebuilds the gaps between the chunks of an opened file from the index.
+    // Space after the last chunk is handed out by `allocate` as the end.
+    void find_gaps() {
+        std::vector<entry> used;
+        for (const entry& e : index_) {
+            if (e.offset != 0) {
+                used.push_back(e);
+            }
+        }
+
+        std::sort(used.begin(), used.end(), [](entry a, entry b) {
+            return a.offset < b.offset;
+        });
+
+        end_ = index_at(chunk_count());
+        for (const entry& e : used) {
+            if (e.offset > end_) {
+                gaps_[end_] = e.offset - end_;
+            }
+
+            end_ = e.offset + e.size > end_ ? e.offset + e.size : end_;
+        }
+    }
+
+    std::unique_ptr<chunked::file> file_;
+    std::unique_ptr<std::mutex> mutex_;
+    bool writable_;
+    shape_type shape_ {};
+    shape_type chunk_shape_ {};
+    shape_type grid_ {};
+    chunk_codec codec_ = chunk_codec::none;
+    std::vector<entry> index_;
+    std::map<uint64_t, uint64_t> gaps_;  // offset and size of unused space
+    uint64_t end_ = 0;  // end of the data in use
+};
+
+}  // namespace capybara
@@ -0,0 +1,368 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace capybara {
+
+/// Compression applied to blocks of elements, see `chunked_file` and
+/// `compressed_array`.
+enum struct chunk_codec : uint8_t {
+    none = 0,
+    shuffle_rle = 1,  // byte shuffle followed by run-length encoding
+    delta_bitpack = 2,  // differences packed in as few bits as needed
+};
+
+namespace codec {
+    // Reorders `count` items of `size` bytes so that byte `b` of every item
+    // ends up in plane `b`. Bytes that vary slowly (the high bytes of small
+    // or sorted numbers) then form long runs.
+    inline void
+    shuffle(const char* src, char* dst, size_t count, size_t size) {
+        for (size_t i = 0; i < count; i++) {
+            for (size_t b = 0; b < size; b++) {
+                dst[b * count + i] = src[i * size + b];
+            }
+        }
+    }
+
+    inline void
+    unshuffle(const char* src, char* dst, size_t count, size_t size) {
+        for (size_t b = 0; b < size; b++) {
+            for (size_t i = 0; i < count; i++) {
+                dst[i * size + b] = src[b * count + i];
+            }
+        }
+    }
+
+    // Run-length encoding with one control byte per run: values below 128
+    // are followed by that many plus one literal bytes, values from 128 up
+    // are followed by one byte that is repeated that many minus 125 times.
+    static constexpr size_t min_repeat = 3;
+    static constexpr size_t max_repeat = 127 + min_repeat;
+    static constexpr size_t max_literal = 128;
+
+    inline void rle_encode(const char* src, size_t n, std::vector<char>& out) {
+        size_t i = 0;
+        size_t literal = 0;  // start of pending literal bytes
+
+        auto flush = [&](size_t end) {
+            while (literal < end) {
+                size_t k = end - literal < max_literal ? end - literal
+                                                       : max_literal;
+                out.push_back(static_cast<char>(k - 1));
+                out.insert(out.end(), src + literal, src + literal + k);
+                literal += k;
+            }
+        };
+
+        while (i < n) {
+            size_t run = 1;
+            while (i + run < n && run < max_repeat && src[i + run] == src[i]) {
+                run++;
+            }
+
+            if (run >= min_repeat) {
+                flush(i);
+                out.push_back(static_cast<char>(128 + run - min_repeat));
+                out.push_back(src[i]);
+                literal = i + run;
+            }
+
+            i += run;
+        }
+
+        flush(n);
+    }
+
+    inline void rle_decode(const char* src, size_t n, char* dst, size_t size) {
+        size_t out = 0;
+
+        for (size_t i = 0; i < n;) {
+            size_t control = static_cast<unsigned char>(src[i++]);
+
+            if (control < 128) {
+                size_t k = control + 1;
+                if (i + k > n || out + k > size) {
+                    break;
+                }
+
+                std::memcpy(dst + out, src + i, k);
+                i += k;
+                out += k;
+            } else {
+                size_t k = control - 128 + min_repeat;
+                if (i + 1 > n || out + k > size) {
+                    break;
+                }
+
+                std::memset(dst + out, src[i], k);
+                i += 1;
+                out += k;
+            }
+        }
+
+        if (out != size) {
+            throw std::runtime_error("corrupt compressed data");
+        }
+    }
+
+    // Reads up to 8 bytes at `offset` as a little-endian word; bytes past
+    // the end of `src` read as zero.
+    inline uint64_t read_word(const char* src, size_t n, size_t offset) {
+        uint64_t word = 0;
+        size_t k = offset + 8 <= n ? 8 : offset < n ? n - offset : 0;
+
+        for (size_t b = 0; b < k; b++) {
+            uint64_t byte = static_cast<unsigned char>(src[offset + b]);
+            word |= byte << (8 * b);
+        }
+
+        return word;
+    }
+
+    // Appends the low `width` bits of every value to `out`, in 64-bit
+    // little-endian words.
+    inline void pack_bits(
+        const uint64_t* values,
+        size_t count,
+        unsigned width,
+        std::vector<char>& out) {
+        uint64_t word = 0;
+        unsigned used = 0;
+
+        auto emit = [&](size_t bytes) {
+            for (size_t b = 0; b < bytes; b++) {
+                out.push_back(static_cast<char>(word >> (8 * b)));
+            }
+        };
+
+        if (width == 0) {
+            return;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            word |= values[i] << used;
+
+            if (used + width >= 64) {
+                emit(8);
+                word = used > 0 ? values[i] >> (64 - used) : 0;
+                used = used + width - 64;
+            } else {
+                used += width;
+            }
+        }
+
+        emit((used + 7) / 8);
+    }
+
+    // Reads `count` values written by `pack_bits` and calls `fun` on each.
+    template<typename F>
+    void unpack_bits(
+        const char* src,
+        size_t n,
+        size_t count,
+        unsigned width,
+        F fun) {
+        uint64_t mask = width < 64 ? (uint64_t(1) << width) - 1 : ~uint64_t(0);
+        uint64_t word = 0;
+        unsigned avail = 0;
+        size_t pos = 0;
+
+        if ((count * width + 7) / 8 > n) {
+            throw std::runtime_error("corrupt compressed data");
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            uint64_t value;
+
+            if (avail >= width) {
+                value = word & mask;
+                word = width < 64 ? word >> width : 0;
+                avail -= width;
+            } else {
+                uint64_t next = read_word(src, n, pos);
+                unsigned taken = width - avail;
+                pos += 8;
+
+                value = (word | next << avail) & mask;
+                word = taken < 64 ? next >> taken : 0;
+                avail = 64 - taken;
+            }
+
+            fun(value);
+        }
+    }
+
+    // Integers as 64-bit patterns, sign-extended if signed, so that
+    // differences wrap around consistently.
+    template<typename T>
+    uint64_t to_bits(T value) {
+        using wide_type = typename std::
+            conditional<std::is_signed<T>::value, int64_t, uint64_t>::type;
+        return static_cast<uint64_t>(static_cast<wide_type>(value));
+    }
+
+    // Stores the first value, followed by the differences between
+    // neighbours in zigzag form (small negative numbers become small
+    // positive numbers), bit-packed with the width of the largest one.
+    // Sorted or slowly changing integers need only a few bits per value.
+    template<typename T>
+    void delta_encode(
+        const T* src,
+        size_t count,
+        std::vector<char>& out,
+        std::true_type) {
+        std::vector<uint64_t> deltas(count > 0 ? count - 1 : 0);
+        uint64_t first = count > 0 ? to_bits(src[0]) : 0;
+        uint64_t previous = first;
+        uint64_t all = 0;
+
+        for (size_t i = 1; i < count; i++) {
+            uint64_t delta = to_bits(src[i]) - previous;
+            previous = to_bits(src[i]);
+            deltas[i - 1] = (delta << 1) ^ (0 - (delta >> 63));
+            all |= deltas[i - 1];
+        }
+
+        unsigned width = 0;
+        while (width < 64 && (all >> width) != 0) {
+            width++;
+        }
+
+        out.push_back(static_cast<char>(width));
+        for (size_t b = 0; b < 8; b++) {
+            out.push_back(static_cast<char>(first >> (8 * b)));
+        }
+
+        pack_bits(deltas.data(), deltas.size(), width, out);
+    }
+
+    template<typename T>
+    void delta_decode(
+        const char* src,
+        size_t n,
+        T* dst,
+        size_t count,
+        std::true_type) {
+        if (n < 9 || static_cast<unsigned char>(src[0]) > 64) {
+            throw std::runtime_error("corrupt compressed data");
+        }
+
+        uint64_t previous = read_word(src, n, 1);
+        size_t i = 0;
+
+        if (count > 0) {
+            dst[i++] = static_cast<T>(previous);
+        }
+
+        unpack_bits(
+            src + 9,
+            n - 9,
+            count > 0 ? count - 1 : 0,
+            static_cast<unsigned char>(src[0]),
+            [&](uint64_t zigzag) {
+                previous += (zigzag >> 1) ^ (0 - (zigzag & 1));
+                dst[i++] = static_cast<T>(previous);
+            });
+    }
+
+    template<typename T>
+    void delta_encode(const T*, size_t, std::vector<char>&, std::false_type) {
+        throw std::runtime_error("delta_bitpack only supports integers");
+    }
+
+    template<typename T>
+    void delta_decode(const char*, size_t, T*, size_t, std::false_type) {
+        throw std::runtime_error("delta_bitpack only supports integers");
+    }
+
+    /// Whether `codec` can compress values of type `T`. Delta encoding
+    /// only applies to integers.
+    template<typename T>
+    constexpr bool supports(chunk_codec codec) {
+        return codec != chunk_codec::delta_bitpack
+            || std::is_integral<T>::value;
+    }
+
+    /// Compresses `count` items of `size` bytes from `src` into `out`.
+    inline void encode(
+        chunk_codec codec,
+        const char* src,
+        size_t count,
+        size_t size,
+        std::vector<char>& out) {
+        out.clear();
+
+        if (codec == chunk_codec::none) {
+            out.assign(src, src + count * size);
+        } else if (codec == chunk_codec::shuffle_rle) {
+            std::vector<char> planes(count * size);
+            shuffle(src, planes.data(), count, size);
+            rle_encode(planes.data(), planes.size(), out);
+        } else {
+            throw std::runtime_error("codec needs the element type");
+        }
+    }
+
+    /// Compresses the `count` values at `src` into `out`.
+    template<typename T>
+    void encode(
+        chunk_codec codec,
+        const T* src,
+        size_t count,
+        std::vector<char>& out) {
+        if (codec == chunk_codec::delta_bitpack) {
+            out.clear();
+            delta_encode(src, count, out, std::is_integral<T> {});
+        } else {
+            const char* bytes = reinterpret_cast<const char*>(src);
+            encode(codec, bytes, count, sizeof(T), out);
+        }
+    }
+
+    /// Decompresses the `n` bytes at `src` into `count` items of `size`
+    /// bytes at `dst`.
+    inline void decode(
+        chunk_codec codec,
+        const char* src,
+        size_t n,
+        char* dst,
+        size_t count,
+        size_t size) {
+        if (codec == chunk_codec::none) {
+            if (n != count * size) {
+                throw std::runtime_error("corrupt uncompressed data");
+            }
+
+            std::memcpy(dst, src, n);
+        } else if (codec == chunk_codec::shuffle_rle) {
+            std::vector<char> planes(count * size);
+            rle_decode(src, n, planes.data(), planes.size());
+            unshuffle(planes.data(), dst, count, size);
+        } else {
+            throw std::runtime_error("codec needs the element type");
+        }
+    }
+
+    /// Decompresses the `n` bytes at `src` into `count` values at `dst`.
+    template<typename T>
+    void decode(
+        chunk_codec codec,
+        const char* src,
+        size_t n,
+        T* dst,
+        size_t count) {
+        if (codec == chunk_codec::delta_bitpack) {
+            delta_decode(src, n, dst, count, std::is_integral<T> {});
+        } else {
+            char* bytes = reinterpret_cast<char*>(dst);
+            decode(codec, src, n, bytes, count, sizeof(T));
+        }
+    }
+}  // namespace codec
+
+}  // namespace capybara
@@ -0,0 +1,251 @@
+#pragma once
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "array.h"
+#include "codec.h"
+#include "eval.h"
+#include "expr.h"
+#include "layout.h"
+
+namespace capybara {
+
+template<typename T, size_t N>
+struct compressed_array;
+
+template<typename T, size_t N>
+struct compressed_cursor;
+
+template<typename T, size_t N>
+struct expr_traits<compressed_array<T, N>> {
+    static constexpr size_t rank = N;
+    using value_type = T;
+    static constexpr bool is_writable = false;
+    static constexpr bool is_view = false;
+};
+
+template<typename T, size_t N, typename D>
+struct expr_cursor<const compressed_array<T, N>, D> {
+    using type = compressed_cursor<T, N>;
+
+    static type
+    call(const compressed_array<T, N>& expr, dshape<N> shape, D device) {
+        if (expr.shape() != shape) {
+            assert_same_shape(expr.shape(), shape);
+        }
+
+        return type(expr);
+    }
+};
+
+/// Read-only array held in memory as separately compressed chunks of
+/// consecutive elements in row-major order (see `chunk_codec`). Reading it
+/// decompresses one chunk at a time into a small buffer, which trades some
+/// CPU time for far less memory and memory traffic when the data compresses
+/// well. Copies share the compressed data.
+///
+/// Reading is only cheap in (roughly) row-major order. A matrix asks the
+/// evaluator to visit it one chunk at a time, also when it is assigned to
+/// a tiled destination. Other orders, such as reading down the columns
+/// through `symmetric`, decompress a chunk for every few elements; evaluate
+/// the array into a plain one first if it is read like that repeatedly.
+template<typename T, size_t N>
+struct compressed_array: expr<compressed_array<T, N>> {
+    static_assert(N > 0, "compressed array must have at least one axis");
+    static_assert(
+        std::is_arithmetic<T>::value,
+        "only arithmetic types can be compressed");
+
+    using base_type = expr<compressed_array<T, N>>;
+    using typename base_type::shape_type;
+
+    /// Integers are delta-encoded; other types are byte-shuffled.
+    static constexpr chunk_codec default_codec = std::is_integral<T>::value
+        ? chunk_codec::delta_bitpack
+        : chunk_codec::shuffle_rle;
+
+    /// Compresses `expr` with chunks of about `chunk_size` elements, rounded
+    /// to whole rows (positions along axis 0). The expression is evaluated
+    /// one chunk at a time, so it is never held uncompressed as a whole.
+    template<typename E>
+    explicit compressed_array(
+        const E& expr,
+        chunk_codec codec = default_codec,
+        size_t chunk_size = 4096) {
+        auto source = into_expr<N>(expr);
+        auto result = std::make_shared<state>();
+        state& s = *result;
+        s.shape = source.shape();
+        s.codec = codec;
+
+        index_t row = 1;
+        for (size_t i = 1; i < N; i++) {
+            row *= s.shape[i];
+        }
+
+        index_t rows = row > 0 ? index_t(chunk_size) / row : 1;
+        rows = rows > 0 ? rows : 1;
+        s.chunk_size = rows * row;
+        s.offsets.push_back(0);
+
+        array<T, N> buffer;
+        std::vector<char> encoded;
+
+        for (index_t begin = 0; begin < s.shape[0]; begin += rows) {
+            dshape<N> offset {};
+            dshape<N> extent = s.shape;
+            offset[0] = begin;
+            extent[0] = s.shape[0] - begin < rows ? s.shape[0] - begin : rows;
+
+            buffer.resize(extent);
+            assign_region(buffer, source, s.shape, offset);
+            codec::encode(codec, buffer.data(), buffer.size(), encoded);
+
+            s.data.insert(s.data.end(), encoded.begin(), encoded.end());
+            s.offsets.push_back(s.data.size());
+        }
+
+        s.data.shrink_to_fit();
+        state_ = std::move(result);
+    }
+
+    CAPYBARA_INLINE
+    index_t dimension_impl(index_t axis) const {
+        return state_->shape[axis];
+    }
+
+    chunk_codec codec() const {
+        return state_->codec;
+    }
+
+    /// Number of elements in every chunk except possibly the last.
+    index_t chunk_size() const {
+        return state_->chunk_size;
+    }
+
+    index_t chunk_count() const {
+        return index_t(state_->offsets.size()) - 1;
+    }
+
+    /// Size in bytes of the compressed data.
+    size_t compressed_size() const {
+        return state_->data.size();
+    }
+
+    /// Decompresses chunk `chunk` into `out`, which has room for
+    /// `chunk_size()` elements.
+    void decompress_chunk(index_t chunk, T* out) const {
+        const state& s = *state_;
+        size_t begin = s.offsets[size_t(chunk)];
+        size_t end = s.offsets[size_t(chunk) + 1];
+        index_t count = index_t(base_type::size()) - chunk * s.chunk_size;
+
+        codec::decode(
+            s.codec,
+            s.data.data() + begin,
+            end - begin,
+            out,
+            size_t(count < s.chunk_size ? count : s.chunk_size));
+    }
+
+  private:
+    struct state {
+        dshape<N> shape;
+        chunk_codec codec;
+        index_t chunk_size;
+        std::vector<char> data;
+        std::vector<size_t> offsets;  // of every chunk in `data`, and the end
+    };
+
+    std::shared_ptr<const state> state_;
+};
+
+// Reads a `compressed_array` in any order. The chunk that holds the current
+// position is decompressed into a buffer when it is first loaded and stays
+// there until a position in another chunk is loaded. The evaluator copies
+// cursors while it walks the axes, but only ever uses one copy at a time,
+// so all copies share a single buffer and check it on every load. Copies
+// must therefore not be used on different threads.
+template<typename T, size_t N>
+struct compressed_cursor {
+    using value_type = T;
+
+    compressed_cursor(const compressed_array<T, N>& array) :
+        array_(&array),
+        scratch_(std::make_shared<scratch>()) {
+        layout::row_major<N> layout(array.shape());
+        strides_ = layout.strides();
+        scratch_->values.reset(new T[size_t(array.chunk_size())]);
+    }
+
+    template<typename Axis, typename Steps>
+    CAPYBARA_INLINE void advance(Axis axis, Steps steps) {
+        offset_ += steps * strides_[axis];
+    }
+
+    template<typename Axis, typename Steps>
+    CAPYBARA_INLINE index_t segment(Axis axis, Steps steps) const {
+        index_t begin = offset_ / array_->chunk_size() * array_->chunk_size();
+        return layout::range_segment(
+            offset_,
+            steps * strides_[axis],
+            begin,
+            begin + array_->chunk_size() - 1);
+    }
+
+    // A matrix is visited one chunk of whole rows at a time. Chunks of
+    // arrays with more axes hold whole slabs along axis 0, so every order
+    // of the last two axes stays within a chunk.
+    CAPYBARA_INLINE
+    index_t block(index_t axis) const {
+        index_t cols = array_->dimension(N - 1);
+
+        if (N != 2 || cols == 0) {
+            return 0;
+        }
+
+        return axis == 0 ? array_->chunk_size() / cols : cols;
+    }
+
+    CAPYBARA_INLINE
+    value_type load() {
+        scratch& s = *scratch_;
+
+        if (offset_ < s.begin || offset_ >= s.end) {
+            index_t chunk = offset_ / array_->chunk_size();
+            array_->decompress_chunk(chunk, s.values.get());
+            s.begin = chunk * array_->chunk_size();
+            s.end = s.begin + array_->chunk_size();
+        }
+
+        return s.values[size_t(offset_ - s.begin)];
+    }
+
+  private:
+    struct scratch {
+        std::unique_ptr<T[]> values;
+        index_t begin = 0;
+        index_t end = 0;
+    };
+
+    const compressed_array<T, N>* array_;
+    layout::strides_type<N> strides_;
+    stride_t offset_ = 0;
+    std::shared_ptr<scratch> scratch_;
+};
+
+template<typename E>
+using compress_type =
+    compressed_array<decay_t<expr_value_type<E>>, expr_rank<E>>;
+
+/// Compresses `expr` into memory, see `compressed_array`.
+template<typename E>
+compress_type<E> compress(
+    const E& expr,
+    chunk_codec codec = compress_type<E>::default_codec,
+    size_t chunk_size = 4096) {
+    return compress_type<E>(expr, codec, chunk_size);
+}
+
+}  // namespace capybara
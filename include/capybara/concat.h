@@ -0,0 +1,273 @@
+#pragma once
+#include <tuple>
+
+#include "expr.h"
+#include "view.h"
+
+namespace capybara {
+template<typename... Cs>
+struct concat_cursor;
+
+template<typename... Es>
+struct concat_expr;
+
+template<typename... Es>
+struct expr_traits<concat_expr<Es...>> {
+    static constexpr size_t rank =
+        std::tuple_element<0, std::tuple<Es...>>::type::rank;
+    static_assert(fun::all(Es::rank == rank...), "invalid rank of operands");
+
+    static constexpr bool is_writable =
+        fun::all(expr_traits<Es>::is_writable...);
+    static constexpr bool is_view = false;
+    using value_type = typename std::common_type<expr_value_type<Es>...>::type;
+};
+
+template<typename... Es, typename D>
+struct expr_cursor<const concat_expr<Es...>, D> {
+    using type = concat_cursor<expr_cursor_type<const Es, D>...>;
+    static constexpr size_t rank = expr_rank<Es...>;
+
+    template<size_t... Is>
+    CAPYBARA_INLINE static type call_helper(
+        const concat_expr<Es...>& expr,
+        dshape<rank> shape,
+        D device,
+        std::index_sequence<Is...>) {
+        index_t axis = expr.axis();
+        typename type::offsets_type offsets = {0};
+        index_t total = 0;
+
+        seq::for_each_n<sizeof...(Es)>([&](auto i) {
+            total += std::get<i>(expr.operands()).dimension(axis);
+            offsets[i + 1] = total;
+        });
+
+        if (shape[axis] != total) {
+            throw std::runtime_error("failed to broadcast shape");
+        }
+
+        return type(
+            axis,
+            offsets,
+            std::get<Is>(expr.operands())
+                .cursor(
+                    segment_shape(shape, axis, offsets[Is + 1] - offsets[Is]),
+                    device)...);
+    }
+
+    CAPYBARA_INLINE
+    static dshape<rank>
+    segment_shape(dshape<rank> shape, index_t axis, index_t length) {
+        shape[axis] = length;
+        return shape;
+    }
+
+    CAPYBARA_INLINE
+    static type
+    call(const concat_expr<Es...>& expr, dshape<rank> shape, D device) {
+        return call_helper(
+            expr,
+            shape,
+            device,
+            std::index_sequence_for<Es...> {});
+    }
+};
+
+template<typename... Es>
+struct expr_prepare_write<concat_expr<Es...>> {
+    static void call(const concat_expr<Es...>& expr) {
+        seq::for_each(expr.operands(), [](const auto& operand) {
+            expr_prepare_write<decay_t<decltype(operand)>>::call(operand);
+        });
+    }
+};
+
+/// Lazy concatenation of several expressions along one axis.
+template<typename... Es>
+struct concat_expr: expr<concat_expr<Es...>> {
+    static_assert(sizeof...(Es) > 0, "nothing to concatenate");
+    static constexpr size_t expr_rank = expr_rank<Es...>;
+
+    concat_expr(index_t axis, Es... operands) :
+        axis_(axis),
+        operands_(std::move(operands)...) {
+        assert_index<expr_rank>(axis);
+    }
+
+    CAPYBARA_INLINE
+    index_t dimension_impl(index_t axis) const {
+        if (axis != axis_) {
+            return dimension_broadcast<std::tuple<Es...>>::call(
+                axis,
+                operands_);
+        }
+
+        return seq::fold(operands_, index_t(0), [axis](index_t n, auto& e) {
+            return n + e.dimension(axis);
+        });
+    }
+
+    CAPYBARA_INLINE
+    index_t axis() const {
+        return axis_;
+    }
+
+    CAPYBARA_INLINE
+    const std::tuple<Es...>& operands() const {
+        return operands_;
+    }
+
+  private:
+    index_t axis_;
+    std::tuple<Es...> operands_;
+};
+
+// All operand cursors advance together along the other axes, but along the
+// concatenation axis only the active operand is moved. Each cursor remembers
+// its own position so it can be picked up again when it becomes active.
+template<typename... Cs>
+struct concat_cursor {
+    static constexpr size_t arity = sizeof...(Cs);
+    using offsets_type = std::array<index_t, arity + 1>;
+    using value_type =
+        typename std::common_type<decltype(std::declval<Cs>().load())...>::type;
+    using first_type = typename std::tuple_element<0, std::tuple<Cs...>>::type;
+    using first_run_type = cursor_run_type<first_type>;
+
+    // Runs can only be handed out if every operand has the same run cursor.
+    static constexpr bool has_uniform_run =
+        fun::all(std::is_same<cursor_run_type<Cs>, first_run_type>::value...);
+
+    concat_cursor(index_t axis, offsets_type offsets, Cs... operands) :
+        axis_(axis),
+        offsets_(offsets),
+        operands_(std::move(operands)...) {
+        locals_.fill(0);
+        seek(0);
+    }
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (axis == axis_) {
+            seek(position_ + steps);
+        } else {
+            seq::for_each(operands_, [axis, steps](auto& cursor) {
+                cursor.advance(axis, steps);
+            });
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        index_t n = tuple_segment(operands_, axis, steps);
+        index_t m = n;
+
+        if (axis == axis_ && steps > 0) {
+            m = (offsets_[index_ + 1] - position_ + steps - 1) / steps;
+        } else if (axis == axis_ && steps < 0) {
+            m = (position_ - offsets_[index_]) / -steps + 1;
+        }
+
+        return n < m ? n : m;
+    }
+
+    // A segment never crosses an operand boundary, so the run is taken by
+    // the active operand's cursor and the loop over it does not dispatch on
+    // the operand for every element.
+    template<bool B = has_uniform_run, typename = enable_t<B>>
+    CAPYBARA_INLINE bool has_run(index_t axis) const {
+        return seq::visit(operands_, index_, [axis](const auto& cursor) {
+            return cursor_run<decay_t<decltype(cursor)>>::available(
+                cursor,
+                axis);
+        });
+    }
+
+    template<bool B = has_uniform_run, typename = enable_t<B>>
+    CAPYBARA_INLINE first_run_type run(index_t axis) const {
+        return seq::visit(
+            operands_,
+            index_,
+            [axis](const auto& cursor) -> first_run_type {
+                return cursor_run<decay_t<decltype(cursor)>>::call(
+                    cursor,
+                    axis);
+            });
+    }
+
+    CAPYBARA_INLINE
+    value_type load() {
+        return seq::visit(operands_, index_, [](auto& cursor) -> value_type {
+            return cursor.load();
+        });
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type v) {
+        seq::visit(operands_, index_, [&v](auto& cursor) {
+            cursor.store(std::move(v));
+        });
+    }
+
+  private:
+    CAPYBARA_INLINE
+    void seek(index_t position) {
+        while (index_ + 1 < arity && position >= offsets_[index_ + 1]) {
+            index_++;
+        }
+
+        while (index_ > 0 && position < offsets_[index_]) {
+            index_--;
+        }
+
+        index_t local = position - offsets_[index_];
+        index_t delta = local - locals_[index_];
+
+        if (delta != 0) {
+            seq::visit(operands_, index_, [this, delta](auto& cursor) {
+                cursor.advance(axis_, delta);
+            });
+        }
+
+        locals_[index_] = local;
+        position_ = position;
+    }
+
+    index_t axis_;
+    index_t position_ = 0;
+    size_t index_ = 0;
+    offsets_type offsets_;
+    std::array<index_t, arity> locals_;
+    std::tuple<Cs...> operands_;
+};
+
+template<typename... Es>
+using expr_concat_type = concat_expr<broadcast_expr_type<Es, Es...>...>;
+
+/// Joins the given expressions along an existing axis.
+template<typename... Es>
+expr_concat_type<Es...> concatenate(index_t axis, Es&&... args) {
+    return expr_concat_type<Es...>(
+        axis,
+        broadcast_expr<Es, Es...>(std::forward<Es>(args))...);
+}
+
+template<typename... Es>
+using expr_stack_type = concat_expr<view_expr<
+    view::insert_axis<expr_rank<Es...>, index_t>,
+    broadcast_expr_type<Es, Es...>>...>;
+
+/// Joins the given expressions along a new axis inserted at `axis`.
+template<typename... Es>
+expr_stack_type<Es...> stack(index_t axis, Es&&... args) {
+    using view_type = view::insert_axis<expr_rank<Es...>, index_t>;
+
+    return expr_stack_type<Es...>(
+        axis,
+        make_view(
+            view_type(axis),
+            broadcast_expr<Es, Es...>(std::forward<Es>(args)))...);
+}
+
+}  // namespace capybara
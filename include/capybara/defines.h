@@ -35,6 +35,13 @@
         } while (1)
 #endif
 
+#if CAPYBARA_GCC_VERSION > 0 || CAPYBARA_MSVC_VERSION > 0 \
+    || CAPYBARA_ICC_VERSION > 0
+    #define CAPYBARA_RESTRICT __restrict
+#else
+    #define CAPYBARA_RESTRICT
+#endif
+
 #define CAPYBARA_LIKELY(expr) (expr)
 
 #define CAPYBARA_TODO(msg)             \
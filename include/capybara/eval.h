@@ -0,0 +1,337 @@
+#pragma once
+
+#include <initializer_list>
+
+#include "array.h"
+#include "expr.h"
+
+namespace capybara {
+
+template<typename A, typename B>
+struct assign_cursor {
+    assign_cursor(A dest, B source) :
+        dest_(std::move(dest)),
+        source_(std::move(source)) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        dest_.advance(axis, steps);
+        source_.advance(axis, steps);
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        index_t n = cursor_segment<A>::call(dest_, axis, steps);
+        index_t m = cursor_segment<B>::call(source_, axis, steps);
+        return n < m ? n : m;
+    }
+
+    // Blocks asked for by the source win: reading a source out of order
+    // (such as a `compressed_array`, which decompresses whole chunks) costs
+    // more than writing a destination out of order.
+    CAPYBARA_INLINE
+    index_t block(index_t axis) const {
+        index_t n = cursor_block<B>::call(source_, axis);
+        return n > 0 ? n : cursor_block<A>::call(dest_, axis);
+    }
+
+    CAPYBARA_INLINE
+    index_t skip(index_t axis, index_t steps) const {
+        return cursor_skip<A>::call(dest_, axis, steps);
+    }
+
+    CAPYBARA_INLINE
+    bool has_run(index_t axis) const {
+        return cursor_run<A>::available(dest_, axis)
+            && cursor_run<B>::available(source_, axis);
+    }
+
+    CAPYBARA_INLINE
+    assign_cursor<cursor_run_type<A>, cursor_run_type<B>>
+    run(index_t axis) const {
+        return {
+            cursor_run<A>::call(dest_, axis),
+            cursor_run<B>::call(source_, axis)};
+    }
+
+    CAPYBARA_INLINE
+    void operator()() {
+        dest_.store(source_.load());
+    }
+
+  private:
+    A dest_;
+    B source_;
+};
+
+// Visits `length` positions along `Axis`, split into runs that do not cross
+// any segment boundary of the cursor, so each run is a plain contiguous loop
+// over the run cursor (see `cursor_run`). Positions that the cursor reports
+// as skippable are not visited at all.
+template<size_t Axis, typename C, typename F>
+CAPYBARA_INLINE void evaluate_run(index_t length, C& cursor, F& fun) {
+    while (length > 0) {
+        index_t skip = cursor_skip<C>::call(cursor, Axis, 1);
+
+        if (skip > 0) {
+            skip = skip > length ? length : skip;
+            cursor.advance(Axis, skip);
+            length -= skip;
+            continue;
+        }
+
+        index_t run = cursor_segment<C>::call(cursor, Axis, 1);
+        run = run < 1 ? 1 : run > length ? length : run;
+
+        if (cursor_run<C>::available(cursor, Axis)) {
+            cursor_run_type<C> inner = cursor_run<C>::call(cursor, Axis);
+
+            for (index_t i = 0; i < run; i++) {
+                fun(inner);
+                inner.advance(Axis, 1);
+            }
+
+            cursor.advance(Axis, run);
+        } else {
+            for (index_t i = 0; i < run; i++) {
+                fun(cursor);
+                cursor.advance(Axis, 1);
+            }
+        }
+
+        length -= run;
+    }
+}
+
+// Visits a `rows` by `cols` plane spanned by `Axis` and `Axis + 1` one block
+// of `block_rows` by `block_cols` positions at a time.
+template<size_t Axis, typename C, typename F>
+CAPYBARA_INLINE void evaluate_blocks(
+    index_t rows,
+    index_t cols,
+    index_t block_rows,
+    index_t block_cols,
+    C cursor,
+    F& fun) {
+    for (index_t i = 0; i < rows; i += block_rows) {
+        index_t n = rows - i < block_rows ? rows - i : block_rows;
+        C block = cursor;
+
+        for (index_t j = 0; j < cols; j += block_cols) {
+            index_t m = cols - j < block_cols ? cols - j : block_cols;
+            C row = block;
+
+            for (index_t k = 0; k < n; k++) {
+                C inner = row;
+                evaluate_run<Axis + 1>(m, inner, fun);
+                row.advance(Axis, 1);
+            }
+
+            block.advance(Axis + 1, m);
+        }
+
+        cursor.advance(Axis, n);
+    }
+}
+
+template<size_t Axis, size_t N, typename = void>
+struct evaluate_axis {
+    template<typename C, typename F>
+    CAPYBARA_INLINE static void call(const dshape<N>& shape, C cursor, F& fun) {
+        if (Axis + 2 == N) {
+            index_t rows = cursor_block<C>::call(cursor, Axis);
+            index_t cols = cursor_block<C>::call(cursor, Axis + 1);
+
+            if (rows > 0 && cols > 0) {
+                evaluate_blocks<Axis>(
+                    shape[Axis],
+                    shape[Axis + 1],
+                    rows,
+                    cols,
+                    std::move(cursor),
+                    fun);
+                return;
+            }
+        }
+
+        for (index_t i = 0; i < shape[Axis]; i++) {
+            evaluate_axis<Axis + 1, N>::call(shape, cursor, fun);
+            cursor.advance(Axis, 1);
+        }
+    }
+};
+
+template<size_t Axis, size_t N>
+struct evaluate_axis<Axis, N, enable_t<Axis + 1 == N>> {
+    template<typename C, typename F>
+    CAPYBARA_INLINE static void call(const dshape<N>& shape, C cursor, F& fun) {
+        evaluate_run<Axis>(shape[Axis], cursor, fun);
+    }
+};
+
+template<size_t N>
+struct evaluate_axis<N, N, enable_t<N == 0>> {
+    template<typename C, typename F>
+    CAPYBARA_INLINE static void call(const dshape<N>& shape, C cursor, F& fun) {
+        fun(cursor);
+    }
+};
+
+/// Calls `fun(cursor)` for every position of `shape`. Positions are visited
+/// in row-major order, unless the cursor asks for blocked traversal of the
+/// last two axes (see `cursor_block`).
+template<size_t N, typename C, typename F>
+CAPYBARA_INLINE void evaluate_cursor(dshape<N> shape, C cursor, F fun) {
+    evaluate_axis<0, N>::call(shape, std::move(cursor), fun);
+}
+
+/// Writes the elements of `source` into `dest`, broadcasting if needed.
+template<typename E, typename F>
+void assign(E&& dest, F&& source) {
+    constexpr size_t rank = expr_rank<E>;
+    auto lhs = into_expr(std::forward<E>(dest));
+    const auto rhs = into_expr<rank>(std::forward<F>(source));
+    dshape<rank> shape = lhs.shape();
+    expr_prepare_write<decltype(lhs)>::call(lhs);
+
+    using cursor_type = assign_cursor<
+        decltype(lhs.cursor(shape, device_seq {})),
+        decltype(rhs.cursor(shape, device_seq {}))>;
+
+    evaluate_cursor(
+        shape,
+        cursor_type(
+            lhs.cursor(shape, device_seq {}),
+            rhs.cursor(shape, device_seq {})),
+        [](auto& cursor) { cursor(); });
+}
+
+/// Writes the block of `source` that starts at `offset` and has the shape
+/// of `dest` into `dest`, where `source` is broadcast to `shape`. Only the
+/// block is evaluated, so a large expression can be processed in parts.
+template<typename E, typename F>
+void assign_region(
+    E&& dest,
+    F&& source,
+    dshape<expr_rank<E>> shape,
+    dshape<expr_rank<E>> offset) {
+    constexpr size_t rank = expr_rank<E>;
+    auto lhs = into_expr(std::forward<E>(dest));
+    const auto rhs = into_expr<rank>(std::forward<F>(source));
+    dshape<rank> region = lhs.shape();
+    expr_prepare_write<decltype(lhs)>::call(lhs);
+
+    for (size_t i = 0; i < rank; i++) {
+        if (offset[i] < 0 || offset[i] + region[i] > shape[i]) {
+            throw std::runtime_error("region out of bounds");
+        }
+    }
+
+    auto src = rhs.cursor(shape, device_seq {});
+    for (size_t i = 0; i < rank; i++) {
+        src.advance(i, offset[i]);
+    }
+
+    using cursor_type = assign_cursor<
+        decltype(lhs.cursor(region, device_seq {})),
+        decltype(src)>;
+
+    evaluate_cursor(
+        region,
+        cursor_type(lhs.cursor(region, device_seq {}), std::move(src)),
+        [](auto& cursor) { cursor(); });
+}
+
+template<typename E>
+using evaluate_type = array<decay_t<expr_value_type<E>>, expr_rank<E>>;
+
+template<typename T, size_t N>
+using reusable_array_type =
+    array_base<layout::default_layout<N>, storage::shared<T>>;
+
+// Finds an array inside `expr` whose buffer can be overwritten with the
+// result: it was moved into the expression, is not shared, has the shape
+// of the result and is read at exactly the position being written.
+// Returns null if there is no such array.
+template<typename E, typename T, size_t N, typename = void>
+struct expr_reuse {
+    static reusable_array_type<T, N>* call(E& expr, const dshape<N>& shape) {
+        return nullptr;
+    }
+};
+
+template<typename T, size_t N>
+struct expr_reuse<reusable_array_type<T, N>, T, N> {
+    static reusable_array_type<T, N>*
+    call(reusable_array_type<T, N>& expr, const dshape<N>& shape) {
+        bool reusable = expr.shape() == shape && expr.storage().unique();
+        return reusable ? &expr : nullptr;
+    }
+};
+
+template<typename F, typename... Es, typename T, size_t N>
+struct expr_reuse<apply_expr<F, Es...>, T, N> {
+    using type = reusable_array_type<T, N>;
+
+    static type* call(apply_expr<F, Es...>& expr, const dshape<N>& shape) {
+        return call_helper(expr, shape, std::index_sequence_for<Es...> {});
+    }
+
+    template<size_t... Is>
+    static type* call_helper(
+        apply_expr<F, Es...>& expr,
+        const dshape<N>& shape,
+        std::index_sequence<Is...>) {
+        type* result = nullptr;
+        (void)std::initializer_list<int> {
+            (result = result != nullptr
+                 ? result
+                 : expr_reuse<Es, T, N>::call(
+                     std::get<Is>(expr.operands()),
+                     shape),
+             0)...};
+        return result;
+    }
+};
+
+/// Evaluates `expr` into an array. If `expr` owns an array that was moved
+/// into it (see `expr_nested`) and that buffer fits the result, the result
+/// is computed in place and takes over that buffer instead of allocating.
+template<typename E>
+evaluate_type<E> evaluate(E&& expr) {
+    using result_type = evaluate_type<E>;
+    using value_type = typename result_type::value_type;
+    constexpr size_t rank = result_type::rank;
+
+    auto source = into_expr(std::forward<E>(expr));
+    dshape<rank> shape = source.shape();
+    auto* buffer =
+        expr_reuse<decltype(source), value_type, rank>::call(source, shape);
+
+    if (buffer != nullptr) {
+        array_ref<value_type, rank> target(buffer->layout(), buffer->data());
+        assign(target, source);
+        return {buffer->layout(), buffer->storage().take_buffer()};
+    }
+
+    result_type result(shape);
+    assign(result, source);
+    return result;
+}
+
+template<typename E>
+using temporary_type = array_base<
+    layout::default_layout<expr_rank<E>>,
+    storage::arena<decay_t<expr_value_type<E>>>>;
+
+/// Evaluates `expr` into an array allocated from the current memory resource
+/// of the thread (see `storage::scoped_resource`), for intermediate results
+/// that do not outlive the scope that set up the resource.
+template<typename E>
+temporary_type<E> evaluate_temporary(E&& expr) {
+    temporary_type<E> result(into_expr(expr).shape());
+    assign(result, std::forward<E>(expr));
+    return result;
+}
+
+}  // namespace capybara
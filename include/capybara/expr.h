@@ -18,8 +18,8 @@ struct expr_base {
     static constexpr size_t rank = traits_type::rank;
     using value_type = typename traits_type::value_type;
     using shape_type = dshape<rank>;
-    using nested_type = typename expr_nested<self_type>::type;
-    using const_nested_type = typename expr_nested<const self_type>::type;
+    using nested_type = typename expr_nested<self_type&>::type;
+    using const_nested_type = typename expr_nested<const self_type&>::type;
 
     template<typename D>
     using cursor_type = typename expr_cursor<self_type, D>::type;
@@ -28,7 +28,7 @@ struct expr_base {
 
     static_assert(
         std::is_same<
-            value_type,
+            typename std::remove_cv<value_type>::type,
             decltype(std::declval<cursor_type<device_seq>>().load())>::value,
         "invalid value type: value_type does not match cursor_type().load()");
 
@@ -91,7 +91,7 @@ struct expr_base {
     }
 
     size_t size() const {
-        index_t result = 0;
+        index_t result = 1;
         seq::for_each_n<rank>([&](auto i) { result *= self().dimension(i); });
         return static_cast<size_t>(result);
     }
@@ -30,6 +30,20 @@ struct select_expr;
 template<typename V, typename E>
 struct view_expr;
 
+template<typename L, typename T, typename = void>
+struct layout_cursor;
+
+template<typename E, typename F>
+void assign(E&& dest, F&& source);
+
+template<typename L, typename = void>
+struct layout_is_strided: std::false_type {};
+
+template<typename L>
+struct layout_is_strided<
+    L,
+    void_t<decltype(std::declval<const L&>().strides())>>: std::true_type {};
+
 template<typename D, typename = void>
 struct expr_traits {};
 
@@ -53,6 +67,16 @@ struct expr_nested<const D&>: expr_nested<const D> {};
 template<typename E>
 using expr_nested_type = typename expr_nested<E>::type;
 
+/// Prepares the destination of `assign` for being written. Copy-on-write
+/// arrays used in an expression (see `storage::shared_ref`) copy their buffer
+/// here if it is shared, since reading them never does. Expressions that
+/// write through their operands forward this to them.
+template<typename E, typename = void>
+struct expr_prepare_write {
+    CAPYBARA_INLINE
+    static void call(const E& expr) {}
+};
+
 template<typename E, typename D, typename = void>
 struct expr_cursor: expr_cursor<const E, D> {};
 
@@ -134,6 +158,129 @@ using expr_value_type = typename expr_traits<into_expr_type<E>>::value_type;
 
 struct device_seq {};
 
+/// Number of consecutive positions (including the current one) that a cursor
+/// visits when repeatedly advanced by `steps` along `axis` before it hits a
+/// discontinuity (wrap-around, segment boundary, etc.). Cursors that have no
+/// such boundaries do not need to implement `segment` and are unbounded.
+template<typename C, typename = void>
+struct cursor_segment {
+    CAPYBARA_INLINE
+    static index_t call(const C& cursor, index_t axis, index_t steps) {
+        return std::numeric_limits<index_t>::max();
+    }
+};
+
+template<typename C>
+struct cursor_segment<
+    C,
+    void_t<decltype(
+        std::declval<const C&>().segment(index_t {}, index_t {}))>> {
+    CAPYBARA_INLINE
+    static index_t call(const C& cursor, index_t axis, index_t steps) {
+        return cursor.segment(axis, steps);
+    }
+};
+
+/// Preferred block length along `axis` when traversing a cursor, or zero if
+/// the cursor has no preference. The evaluator visits the last two axes in
+/// blocks of this size, for example one storage tile at a time.
+template<typename C, typename = void>
+struct cursor_block {
+    CAPYBARA_INLINE
+    static index_t call(const C& cursor, index_t axis) {
+        return 0;
+    }
+};
+
+template<typename C>
+struct cursor_block<
+    C,
+    void_t<decltype(std::declval<const C&>().block(index_t {}))>> {
+    CAPYBARA_INLINE
+    static index_t call(const C& cursor, index_t axis) {
+        return cursor.block(axis);
+    }
+};
+
+/// Number of consecutive positions (like `cursor_segment`) that are not
+/// backed by storage, so that stores to them have no effect and an evaluator
+/// writing through the cursor can skip them. Zero by default.
+template<typename C, typename = void>
+struct cursor_skip {
+    CAPYBARA_INLINE
+    static index_t call(const C& cursor, index_t axis, index_t steps) {
+        return 0;
+    }
+};
+
+template<typename C>
+struct cursor_skip<
+    C,
+    void_t<decltype(std::declval<const C&>().skip(index_t {}, index_t {}))>> {
+    CAPYBARA_INLINE
+    static index_t call(const C& cursor, index_t axis, index_t steps) {
+        return cursor.skip(axis, steps);
+    }
+};
+
+/// Cursor that visits a run of positions along `axis` that `segment`
+/// reported as free of boundaries. Cursors that check for boundaries on every
+/// step (like `pad` and `roll`) hand out their operand's cursor here, so the
+/// run has no checks at all. The run cursor is only advanced along `axis` and
+/// then dropped, after which the original cursor is moved past the run.
+/// `available` is false if the cursor has no such run at its position. By
+/// default, the run cursor is a copy of the cursor itself.
+template<typename C, typename = void>
+struct cursor_run {
+    using type = C;
+
+    CAPYBARA_INLINE
+    static bool available(const C& cursor, index_t axis) {
+        return true;
+    }
+
+    CAPYBARA_INLINE
+    static type call(const C& cursor, index_t axis) {
+        return cursor;
+    }
+};
+
+template<typename C>
+struct cursor_run<
+    C,
+    void_t<decltype(std::declval<const C&>().run(index_t {}))>> {
+    using type = decltype(std::declval<const C&>().run(index_t {}));
+
+    CAPYBARA_INLINE
+    static bool available(const C& cursor, index_t axis) {
+        return cursor.has_run(axis);
+    }
+
+    CAPYBARA_INLINE
+    static type call(const C& cursor, index_t axis) {
+        return cursor.run(axis);
+    }
+};
+
+template<typename C>
+using cursor_run_type = typename cursor_run<C>::type;
+
+/// Smallest `cursor_segment` over a tuple of cursors that advance together.
+template<typename Tuple>
+CAPYBARA_INLINE index_t
+tuple_segment(const Tuple& cursors, index_t axis, index_t steps) {
+    return seq::fold(
+        cursors,
+        std::numeric_limits<index_t>::max(),
+        [axis, steps](index_t result, const auto& cursor) {
+            index_t n = cursor_segment<decay_t<decltype(cursor)>>::call(
+                cursor,
+                axis,
+                steps);
+            return n < result ? n : result;
+        });
+}
+
 // Where should this go?
 template<
     typename Tuple,
@@ -0,0 +1,174 @@
+#pragma once
+#include "array.h"
+#include "layout.h"
+
+namespace capybara {
+
+enum struct halo_mode {
+    periodic,  // copy from the opposite side of the domain
+    constant,  // fill with a fixed value
+    edge,  // repeat the outermost interior element
+};
+
+template<size_t N, size_t W, typename S>
+using halo_array_type = array_base<layout::halo<N, W>, S>;
+
+/// Returns a view of the interior of `array` shifted by `offsets`, which may
+/// reach at most `W` elements into the halo along every axis. Bounds are
+/// checked once here, not when the view is read.
+template<size_t N, size_t W, typename S>
+strided_array_ref<typename S::value_type, N>
+halo_view(halo_array_type<N, W, S>& array, dshape<N> offsets) {
+    using layout_type = layout::strided<N>;
+    using storage_type = storage::span<typename S::value_type>;
+    auto* data = array.data();
+
+    for (size_t i = 0; i < N; i++) {
+        if (offsets[i] < -index_t(W) || offsets[i] > index_t(W)) {
+            throw std::runtime_error("offset exceeds halo width");
+        }
+
+        data += offsets[i] * array.stride(i);
+    }
+
+    return {layout_type(array.shape(), array.strides()), storage_type(data)};
+}
+
+template<size_t N, size_t W, typename S>
+strided_array_ref<typename S::const_value_type, N>
+halo_view(const halo_array_type<N, W, S>& array, dshape<N> offsets) {
+    using layout_type = layout::strided<N>;
+    using storage_type = storage::span<typename S::const_value_type>;
+    auto* data = array.data();
+
+    for (size_t i = 0; i < N; i++) {
+        if (offsets[i] < -index_t(W) || offsets[i] > index_t(W)) {
+            throw std::runtime_error("offset exceeds halo width");
+        }
+
+        data += offsets[i] * array.stride(i);
+    }
+
+    return {layout_type(array.shape(), array.strides()), storage_type(data)};
+}
+
+// Fills the halo on both sides of `axis` for the lines `begin..end`, where a
+// line is a position on all other axes. Axes before `axis` include their
+// halo (filled earlier), so corners are filled as well.
+template<size_t N, typename T>
+void fill_halo_lines(
+    T* data,
+    dshape<N> shape,
+    layout::strides_type<N> strides,
+    index_t width,
+    size_t axis,
+    halo_mode mode,
+    const T& value,
+    index_t begin,
+    index_t end) {
+    dshape<N> lo;
+    dshape<N> extent;
+    dshape<N> index;
+
+    for (size_t i = 0; i < N; i++) {
+        lo[i] = i < axis ? -width : 0;
+        extent[i] = i < axis ? shape[i] + 2 * width : shape[i];
+    }
+
+    extent[axis] = 1;
+    for (size_t i = 0; i < N; i++) {
+        if (extent[i] == 0) {
+            return;
+        }
+    }
+
+    // Translate the first line into an index
+    index_t rest = begin;
+    for (size_t i = N; i > 0; i--) {
+        index[i - 1] = lo[i - 1] + rest % extent[i - 1];
+        rest /= extent[i - 1];
+    }
+
+    index_t n = shape[axis];
+    stride_t stride = strides[axis];
+
+    for (index_t line = begin; line < end; line++) {
+        T* base = data;
+        for (size_t i = 0; i < N; i++) {
+            base += index[i] * strides[i];
+        }
+
+        for (index_t k = 1; k <= width; k++) {
+            T* before = base - k * stride;
+            T* after = base + (n - 1 + k) * stride;
+
+            if (mode == halo_mode::constant || n == 0) {
+                *before = value;
+                *after = value;
+            } else if (mode == halo_mode::edge) {
+                *before = base[0];
+                *after = base[(n - 1) * stride];
+            } else {
+                *before = base[((n - k % n) % n) * stride];
+                *after = base[((k - 1) % n) * stride];
+            }
+        }
+
+        // Move to the next line
+        for (size_t i = N; i > 0; i--) {
+            if (++index[i - 1] < lo[i - 1] + extent[i - 1]) {
+                break;
+            }
+
+            index[i - 1] = lo[i - 1];
+        }
+    }
+}
+
+/// Fills the halo of `array` according to `mode`. The work for every axis
+/// is split among `threads` threads.
+template<size_t N, size_t W, typename S>
+void fill_halo(
+    halo_array_type<N, W, S>& array,
+    halo_mode mode,
+    typename S::value_type value = {},
+    size_t threads = 1) {
+    using T = typename S::value_type;
+    T* data = array.data();
+    dshape<N> shape = array.shape();
+    layout::strides_type<N> strides = array.strides();
+    index_t width = index_t(W);
+
+    for (size_t axis = 0; axis < N; axis++) {
+        index_t lines = 1;
+        for (size_t i = 0; i < N; i++) {
+            if (i < axis) {
+                lines *= shape[i] + 2 * width;
+            } else if (i > axis) {
+                lines *= shape[i];
+            }
+        }
+
+        index_t parts = index_t(threads) < lines ? index_t(threads) : lines;
+        if (parts < 1) {
+            parts = 1;
+        }
+
+        auto work = [&, axis, parts, lines](size_t worker, index_t i) {
+            fill_halo_lines<N, T>(
+                data,
+                shape,
+                strides,
+                width,
+                axis,
+                mode,
+                value,
+                lines * i / parts,
+                lines * (i + 1) / parts);
+        };
+
+        parallel_for(parts, threads, work);
+    }
+}
+
+}  // namespace capybara
@@ -0,0 +1,1215 @@
+#pragma once
+
+#include <array>
+#include <stdexcept>
+
+#include "forwards.h"
+
+namespace capybara {
+namespace layout {
+    template<size_t N>
+    using strides_type = std::array<stride_t, N>;
+
+    /// Number of elements a buffer needs to hold every element of `shape`
+    /// laid out with the given (non-negative) `strides`.
+    template<size_t N>
+    CAPYBARA_INLINE size_t
+    required_size(const dshape<N>& shape, const strides_type<N>& strides) {
+        size_t result = 1;
+
+        for (size_t i = 0; i < N; i++) {
+            if (shape[i] == 0) {
+                return 0;
+            }
+
+            if (strides[i] > 0) {
+                result += static_cast<size_t>((shape[i] - 1) * strides[i]);
+            }
+        }
+
+        return result;
+    }
+
+    template<size_t N>
+    struct row_major {
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        row_major() = default;
+        row_major(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            stride_t stride = 1;
+
+            for (size_t i = N; i > 0; i--) {
+                strides_[i - 1] = stride;
+                stride *= static_cast<stride_t>(shape[i - 1]);
+            }
+
+            shape_ = shape;
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return layout::required_size(shape_, strides_);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+    };
+
+    template<size_t N>
+    struct col_major {
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        col_major() = default;
+        col_major(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            stride_t stride = 1;
+
+            for (size_t i = 0; i < N; i++) {
+                strides_[i] = stride;
+                stride *= static_cast<stride_t>(shape[i]);
+            }
+
+            shape_ = shape;
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return layout::required_size(shape_, strides_);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+    };
+
+    /// Row-major layout where consecutive rows (the last axis) start `pitch`
+    /// elements apart. The pitch is the row length rounded up to a multiple
+    /// of `Align` elements. If the pitch is a multiple of `Critical` elements,
+    /// another `Align` elements are added, since such strides map every row
+    /// onto the same cache sets. `dimension` still reports the logical shape.
+    template<size_t N, size_t Align = 16, size_t Critical = 512>
+    struct padded {
+        static_assert(Align > 0, "alignment cannot be zero");
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        padded() = default;
+        padded(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            stride_t stride = 1;
+
+            for (size_t i = N; i > 0; i--) {
+                strides_[i - 1] = stride;
+                stride *= static_cast<stride_t>(shape[i - 1]);
+
+                if (i == N) {
+                    stride = pitch(stride);
+                }
+            }
+
+            shape_ = shape;
+        }
+
+        /// Distance between the starts of two rows of `length` elements.
+        static stride_t pitch(stride_t length) {
+            constexpr stride_t align = Align;
+            constexpr stride_t critical = Critical;
+            stride_t result = (length + align - 1) / align * align;
+
+            if (critical > 0 && result > 0 && result % critical == 0) {
+                result += align;
+            }
+
+            return result;
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return layout::required_size(shape_, strides_);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+    };
+
+    /// Row-major layout that reserves `W` extra elements on both sides of
+    /// every axis. `dimension` reports the interior; the data pointer of an
+    /// array refers to the first interior element, so the halo is found at
+    /// negative indices and at indices beyond the dimension.
+    template<size_t N, size_t W = 1>
+    struct halo {
+        static constexpr size_t rank = N;
+        static constexpr index_t width = index_t(W);
+        using shape_type = dshape<N>;
+
+        halo() = default;
+        halo(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            stride_t stride = 1;
+            origin_ = 0;
+
+            for (size_t i = N; i > 0; i--) {
+                strides_[i - 1] = stride;
+                origin_ += width * stride;
+                stride *= static_cast<stride_t>(shape[i - 1] + 2 * width);
+            }
+
+            shape_ = shape;
+            size_ = static_cast<size_t>(stride);
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        stride_t origin() const {
+            return origin_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return size_;
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+        stride_t origin_ = 0;
+        size_t size_ = 0;
+    };
+
+    /// Arbitrary strides, for example to wrap memory owned by someone else.
+    /// Strides may be negative, in which case the data pointer refers to
+    /// element `(0, ..., 0)` and the buffer extends before it. Such layouts
+    /// are only meaningful with non-owning storage (`storage::span`).
+    template<size_t N>
+    struct strided {
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        strided() = default;
+        strided(shape_type shape) {
+            resize(shape);
+        }
+
+        strided(shape_type shape, strides_type<N> strides) :
+            shape_(shape),
+            strides_(strides) {}
+
+        template<
+            typename L,
+            typename =
+                enable_t<L::rank == N && !std::is_same<L, strided>::value>>
+        strided(const L& layout) {
+            for (size_t i = 0; i < N; i++) {
+                shape_[i] = layout.dimension(i);
+                strides_[i] = layout.stride(i);
+            }
+        }
+
+        /// Resizing resets the strides to a contiguous row-major order.
+        void resize(shape_type shape) {
+            shape_ = shape;
+            strides_ = row_major<N>(shape).strides();
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return layout::required_size(shape_, strides_);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+    };
+
+    /// Stores the last two axes in contiguous row-major tiles of `TM` by `TN`
+    /// elements; the tiles themselves and any leading axes are in row-major
+    /// order. Tiles on the edge are allocated in full.
+    template<size_t N, size_t TM, size_t TN>
+    struct tiled {
+        static_assert(N >= 2, "tiled layout requires at least two axes");
+        static_assert(TM > 0 && TN > 0, "tile size cannot be zero");
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        tiled() = default;
+        tiled(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            index_t tile_rows = (shape[N - 2] + TM - 1) / TM;
+            index_t tile_cols = (shape[N - 1] + TN - 1) / TN;
+            stride_t stride = TM * TN;
+
+            strides_[N - 1] = stride;
+            stride *= tile_cols;
+            strides_[N - 2] = stride;
+            stride *= tile_rows;
+
+            for (size_t i = N - 2; i > 0; i--) {
+                strides_[i - 1] = stride;
+                stride *= static_cast<stride_t>(shape[i - 1]);
+            }
+
+            shape_ = shape;
+            size_ = static_cast<size_t>(stride);
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        /// Distance between consecutive planes for the leading axes, between
+        /// rows of tiles for axis `N-2` and between tiles for axis `N-1`.
+        CAPYBARA_INLINE
+        const strides_type<N>& block_strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return size_;
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+        size_t size_ = 0;
+    };
+
+    /// Scatters the low bits of `value` onto the set bits of `mask`.
+    CAPYBARA_INLINE
+    size_t dilate(size_t value, size_t mask) {
+        size_t result = 0;
+
+        while (mask != 0 && value != 0) {
+            size_t lowest = mask & (~mask + 1);
+
+            if (value & 1) {
+                result |= lowest;
+            }
+
+            mask ^= lowest;
+            value >>= 1;
+        }
+
+        return result;
+    }
+
+    /// Stores elements in Morton (Z-order) by interleaving the bits of the
+    /// indices. Every axis is padded to a power of two; axes with more bits
+    /// than others keep their remaining high bits on top.
+    ///
+    /// Neighbours along every axis are usually close in memory, so stencils
+    /// that look in all directions touch fewer cache lines and pages than in
+    /// row-major order. In exchange, moving the cursor costs a few bit
+    /// operations instead of one add, padding can nearly double the storage
+    /// per axis, and plain row-by-row sweeps no longer read memory linearly,
+    /// so they are slower than in row-major order.
+    template<size_t N>
+    struct morton {
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+        using masks_type = std::array<size_t, N>;
+
+        morton() = default;
+        morton(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            std::array<size_t, N> bits;
+            size_t total = 0;
+            size_t max_bits = 0;
+
+            for (size_t i = 0; i < N; i++) {
+                bits[i] = 0;
+                masks_[i] = 0;
+
+                while ((index_t(1) << bits[i]) < shape[i]) {
+                    bits[i]++;
+                }
+
+                total += bits[i];
+                max_bits = bits[i] > max_bits ? bits[i] : max_bits;
+            }
+
+            if (total >= 8 * sizeof(size_t)) {
+                throw std::runtime_error("shape too large for morton layout");
+            }
+
+            // The last axis gets the lowest bit of every level.
+            size_t position = 0;
+            for (size_t level = 0; level < max_bits; level++) {
+                for (size_t i = N; i > 0; i--) {
+                    if (level < bits[i - 1]) {
+                        masks_[i - 1] |= size_t(1) << position++;
+                    }
+                }
+            }
+
+            shape_ = shape;
+            size_ = size_t(1) << total;
+
+            for (size_t i = 0; i < N; i++) {
+                if (shape[i] == 0) {
+                    size_ = 0;
+                }
+            }
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        /// Bits of the storage offset that hold the index of each axis.
+        CAPYBARA_INLINE
+        const masks_type& masks() const {
+            return masks_;
+        }
+
+        CAPYBARA_INLINE
+        size_t offset(const shape_type& index) const {
+            size_t result = 0;
+
+            for (size_t i = 0; i < N; i++) {
+                result |= dilate(static_cast<size_t>(index[i]), masks_[i]);
+            }
+
+            return result;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return size_;
+        }
+
+      private:
+        shape_type shape_;
+        masks_type masks_;
+        size_t size_ = 0;
+    };
+
+    /// Square matrix of which only the lower (`Upper == false`) or upper
+    /// triangle, including the diagonal, is stored. Rows are packed one after
+    /// the other. Elements of the other triangle read as zero.
+    template<bool Upper>
+    struct packed_triangular {
+        static constexpr size_t rank = 2;
+        using shape_type = dshape<2>;
+
+        packed_triangular() = default;
+        packed_triangular(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            if (shape[0] != shape[1]) {
+                throw std::runtime_error("packed layout requires square shape");
+            }
+
+            size_ = shape[0];
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return size_;
+        }
+
+        CAPYBARA_INLINE
+        bool is_stored(index_t i, index_t j) const {
+            return Upper ? j >= i : j <= i;
+        }
+
+        /// Offset of (the possibly not stored) element `(i, 0)`, such that
+        /// stored element `(i, j)` is found at `row_offset(i) + j`.
+        CAPYBARA_INLINE
+        stride_t row_offset(index_t i) const {
+            return Upper ? i * (2 * size_ - i - 1) / 2 : i * (i + 1) / 2;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return static_cast<size_t>(size_ * (size_ + 1) / 2);
+        }
+
+      private:
+        index_t size_ = 0;
+    };
+
+    /// Number of positions visited from `(row, col)` when moving by `steps`
+    /// along `axis` before leaving or entering the lower (or upper) triangle.
+    template<bool Upper>
+    CAPYBARA_INLINE index_t
+    triangle_segment(index_t row, index_t col, index_t axis, index_t steps) {
+        // Inside the triangle iff `e <= 0`.
+        index_t sign = Upper ? -1 : 1;
+        index_t e = sign * (col - row);
+        index_t delta = sign * (axis == 0 ? -steps : steps);
+
+        if (delta > 0 && e <= 0) {
+            return -e / delta + 1;
+        } else if (delta < 0 && e > 0) {
+            return (e - delta - 1) / -delta;
+        } else {
+            return std::numeric_limits<index_t>::max();
+        }
+    }
+
+    using packed_lower = packed_triangular<false>;
+    using packed_upper = packed_triangular<true>;
+
+    /// Number of positions visited when repeatedly adding `delta` to `value`
+    /// before it enters or leaves the range `[lo, hi]`.
+    CAPYBARA_INLINE
+    index_t
+    range_segment(index_t value, index_t delta, index_t lo, index_t hi) {
+        if (delta > 0 && value < lo) {
+            return (lo - value + delta - 1) / delta;
+        } else if (delta > 0 && value <= hi) {
+            return (hi - value) / delta + 1;
+        } else if (delta < 0 && value > hi) {
+            return (value - hi - delta - 1) / -delta;
+        } else if (delta < 0 && value >= lo) {
+            return (value - lo) / -delta + 1;
+        } else {
+            return std::numeric_limits<index_t>::max();
+        }
+    }
+
+    /// Matrix of which only the `KL` sub-diagonals, the main diagonal and the
+    /// `KU` super-diagonals are stored. Every row holds `KL + KU + 1` slots,
+    /// so the stored elements lie on a regular grid: `(i, j)` is found at
+    /// offset `i * (KL + KU) + j + KL`. Other elements read as zero.
+    template<size_t KL, size_t KU>
+    struct banded {
+        static constexpr size_t rank = 2;
+        static constexpr index_t width = index_t(KL + KU + 1);
+        using shape_type = dshape<2>;
+
+        banded() = default;
+        banded(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            shape_ = shape;
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        static bool is_stored(index_t i, index_t j) {
+            return j - i >= -index_t(KL) && j - i <= index_t(KU);
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return static_cast<size_t>(shape_[0] * width);
+        }
+
+      private:
+        shape_type shape_;
+    };
+
+    /// Interleaved (array-of-structures) storage of `C` channels, such as
+    /// RGB pixels. The last axis is the channel axis and always has length
+    /// `C`; memory order is row-major, so the channels of one pixel are
+    /// adjacent.
+    template<size_t N, size_t C>
+    struct interleaved {
+        static_assert(N >= 1, "interleaved layout requires a channel axis");
+        static_assert(C > 0, "channel count cannot be zero");
+        static constexpr size_t rank = N;
+        static constexpr size_t channels = C;
+        using shape_type = dshape<N>;
+
+        interleaved() = default;
+        interleaved(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            if (shape[N - 1] != index_t(C)) {
+                throw std::runtime_error("channel axis must match channels");
+            }
+
+            shape_ = shape;
+            strides_ = row_major<N>(shape).strides();
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return layout::required_size(shape_, strides_);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+    };
+
+    /// One channel of an `interleaved<N + 1, C>` buffer: a row-major layout
+    /// of the pixel axes in which consecutive elements are `C` apart.
+    template<size_t N, size_t C>
+    struct channel_plane {
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        channel_plane() = default;
+        channel_plane(shape_type shape) {
+            resize(shape);
+        }
+
+        void resize(shape_type shape) {
+            shape_ = shape;
+            strides_ = row_major<N>(shape).strides();
+
+            for (size_t i = 0; i < N; i++) {
+                strides_[i] *= stride_t(C);
+            }
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        stride_t stride(index_t axis) const {
+            return strides_[axis];
+        }
+
+        CAPYBARA_INLINE
+        const strides_type<N>& strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return layout::required_size(shape_, strides_);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+    };
+
+    /// Circular buffer along axis 0, for keeping the last `capacity` rows of
+    /// a stream. Rows are stored row-major in `capacity` slots and logical
+    /// row `i` lives in slot `(head + i) % capacity`, so adding a row (see
+    /// `push`) overwrites one slot instead of shifting the others.
+    template<size_t N>
+    struct ring {
+        static_assert(N >= 1, "ring layout requires at least one axis");
+        static constexpr size_t rank = N;
+        using shape_type = dshape<N>;
+
+        ring() = default;
+        ring(shape_type shape) {
+            resize(shape);
+        }
+
+        ring(shape_type shape, index_t capacity) : capacity_(capacity) {
+            resize(shape);
+        }
+
+        /// Sets the shape; rows are kept in slot order from slot zero. The
+        /// capacity grows if `shape[0]` exceeds it.
+        void resize(shape_type shape) {
+            stride_t stride = 1;
+
+            for (size_t i = N; i > 0; i--) {
+                strides_[i - 1] = stride;
+                stride *= static_cast<stride_t>(shape[i - 1]);
+            }
+
+            capacity_ = shape[0] > capacity_ ? shape[0] : capacity_;
+            shape_ = shape;
+            head_ = 0;
+        }
+
+        /// Makes room for one more row at the end of the window and returns
+        /// its slot. If the window is full, the oldest row is dropped.
+        index_t push() {
+            if (capacity_ == 0) {
+                throw std::runtime_error("ring has no capacity");
+            }
+
+            if (shape_[0] < capacity_) {
+                return (head_ + shape_[0]++) % capacity_;
+            }
+
+            index_t slot = head_;
+            head_ = (head_ + 1) % capacity_;
+            return slot;
+        }
+
+        /// Empties the window, keeping the capacity.
+        void clear() {
+            shape_[0] = 0;
+            head_ = 0;
+        }
+
+        CAPYBARA_INLINE
+        index_t dimension(index_t axis) const {
+            return shape_[axis];
+        }
+
+        CAPYBARA_INLINE
+        index_t capacity() const {
+            return capacity_;
+        }
+
+        CAPYBARA_INLINE
+        index_t head() const {
+            return head_;
+        }
+
+        /// Row-major strides of the slots.
+        CAPYBARA_INLINE
+        const strides_type<N>& slot_strides() const {
+            return strides_;
+        }
+
+        CAPYBARA_INLINE
+        size_t required_size() const {
+            return static_cast<size_t>(capacity_ * strides_[0]);
+        }
+
+      private:
+        shape_type shape_;
+        strides_type<N> strides_;
+        index_t capacity_ = 0;
+        index_t head_ = 0;
+    };
+
+    template<size_t N>
+    using default_layout = row_major<N>;
+}  // namespace layout
+
+template<typename T, size_t N, size_t TM, size_t TN>
+struct tiled_cursor {
+    using value_type = typename std::remove_const<T>::type;
+    static constexpr index_t row_axis = index_t(N) - 2;
+    static constexpr index_t col_axis = index_t(N) - 1;
+
+    tiled_cursor(T* data, layout::strides_type<N> strides) :
+        data_(data),
+        strides_(strides) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (axis == col_axis) {
+            move(col_, steps, TN, 1, strides_[col_axis]);
+        } else if (axis == row_axis) {
+            move(row_, steps, TM, TN, strides_[row_axis]);
+        } else {
+            data_ += strides_[axis] * steps;
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        index_t pos = axis == col_axis ? col_ : row_;
+        index_t tile = axis == col_axis ? TN : TM;
+
+        if (axis < row_axis || steps == 0) {
+            return std::numeric_limits<index_t>::max();
+        } else if (steps > 0) {
+            return (tile - pos + steps - 1) / steps;
+        } else {
+            return pos / -steps + 1;
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t block(index_t axis) const {
+        return axis == col_axis ? TN : axis == row_axis ? TM : 0;
+    }
+
+    CAPYBARA_INLINE
+    value_type load() const {
+        return *data_;
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type value) {
+        *data_ = std::move(value);
+    }
+
+  private:
+    CAPYBARA_INLINE
+    void move(
+        index_t& local,
+        index_t steps,
+        index_t tile,
+        stride_t inner,
+        stride_t outer) {
+        index_t next = local + steps;
+
+        if (CAPYBARA_LIKELY(next >= 0 && next < tile)) {
+            data_ += steps * inner;
+        } else {
+            // floor(next / tile), also for negative positions
+            index_t tiles =
+                next >= 0 ? next / tile : -((tile - 1 - next) / tile);
+            next -= tiles * tile;
+            data_ += (next - local) * inner + tiles * outer;
+        }
+
+        local = next;
+    }
+
+    T* data_;
+    layout::strides_type<N> strides_;
+    index_t row_ = 0;
+    index_t col_ = 0;
+};
+
+template<size_t N, size_t TM, size_t TN, typename T>
+struct layout_cursor<layout::tiled<N, TM, TN>, T> {
+    using type = tiled_cursor<T, N, TM, TN>;
+
+    CAPYBARA_INLINE
+    static type call(const layout::tiled<N, TM, TN>& layout, T* data) {
+        return type(data, layout.block_strides());
+    }
+};
+
+// Moves are done directly on the Morton code: adding a dilated integer to
+// the bits of one axis, with the other bits forced to one so that carries
+// skip over them. Indices wrap around within the padded extent, so the
+// cursor never points outside of the buffer.
+template<typename T, size_t N>
+struct morton_cursor {
+    using value_type = typename std::remove_const<T>::type;
+    using masks_type = typename layout::morton<N>::masks_type;
+
+    // Traverse the last two axes in blocks of 8x8 elements. For two axes of
+    // at least 8 elements each, such a block is one aligned Z-order cell of
+    // 64 consecutive elements. If an axis has fewer bits, the other axis
+    // takes over the low bits, and with more axes their bits lie in between,
+    // so the block is then spread over a wider range of memory.
+    static constexpr index_t block_length = 8;
+
+    morton_cursor(T* data, masks_type masks) : data_(data), masks_(masks) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        size_t mask = masks_[axis];
+        size_t bits = code_ & mask;
+
+        if (steps == 1) {
+            bits = ((code_ | ~mask) + 1) & mask;
+        } else if (steps == -1) {
+            bits = (bits - 1) & mask;
+        } else if (steps > 0) {
+            bits = ((code_ | ~mask) + layout::dilate(size_t(steps), mask))
+                & mask;
+        } else if (steps < 0) {
+            bits = (bits - layout::dilate(size_t(-steps), mask)) & mask;
+        }
+
+        code_ = (code_ & ~mask) | bits;
+    }
+
+    CAPYBARA_INLINE
+    index_t block(index_t axis) const {
+        return N >= 2 && axis + 2 >= index_t(N) ? block_length : 0;
+    }
+
+    CAPYBARA_INLINE
+    value_type load() const {
+        return data_[code_];
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type value) {
+        data_[code_] = std::move(value);
+    }
+
+  private:
+    T* data_;
+    masks_type masks_;
+    size_t code_ = 0;
+};
+
+template<size_t N, typename T>
+struct layout_cursor<layout::morton<N>, T> {
+    using type = morton_cursor<T, N>;
+
+    CAPYBARA_INLINE
+    static type call(const layout::morton<N>& layout, T* data) {
+        return type(data, layout.masks());
+    }
+};
+
+// Tracks the row and column to decide whether an element is stored. Stores
+// to the triangle that is not stored are discarded.
+template<typename T, bool Upper>
+struct packed_cursor {
+    using value_type = typename std::remove_const<T>::type;
+    using layout_type = layout::packed_triangular<Upper>;
+
+    packed_cursor(T* data, layout_type layout) :
+        data_(data),
+        layout_(layout) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (axis == 0) {
+            row_ += steps;
+            offset_ = layout_.row_offset(row_);
+        } else {
+            col_ += steps;
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        return layout::triangle_segment<Upper>(row_, col_, axis, steps);
+    }
+
+    CAPYBARA_INLINE
+    index_t skip(index_t axis, index_t steps) const {
+        if (layout_.is_stored(row_, col_)) {
+            return 0;
+        }
+
+        return layout::triangle_segment<Upper>(row_, col_, axis, steps);
+    }
+
+    CAPYBARA_INLINE
+    value_type load() const {
+        if (layout_.is_stored(row_, col_)) {
+            return data_[offset_ + col_];
+        }
+
+        return value_type {};
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type value) {
+        if (layout_.is_stored(row_, col_)) {
+            data_[offset_ + col_] = std::move(value);
+        }
+    }
+
+  private:
+    T* data_;
+    layout_type layout_;
+    index_t row_ = 0;
+    index_t col_ = 0;
+    stride_t offset_ = 0;
+};
+
+template<bool Upper, typename T>
+struct layout_cursor<layout::packed_triangular<Upper>, T> {
+    using type = packed_cursor<T, Upper>;
+
+    CAPYBARA_INLINE
+    static type
+    call(const layout::packed_triangular<Upper>& layout, T* data) {
+        return type(data, layout);
+    }
+};
+
+// Like an array cursor with strides `(KL + KU, 1)`, but elements off the band
+// read as zero and stores to them are discarded. The evaluator skips them
+// when writing, so updates only cost O(rows * bandwidth).
+template<typename T, size_t KL, size_t KU>
+struct banded_cursor {
+    using value_type = typename std::remove_const<T>::type;
+
+    banded_cursor(T* data) : data_(data) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (axis == 0) {
+            offset_ += steps * index_t(KL + KU);
+            diagonal_ -= steps;
+        } else {
+            offset_ += steps;
+            diagonal_ += steps;
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        return layout::range_segment(
+            diagonal_,
+            axis == 0 ? -steps : steps,
+            -index_t(KL),
+            index_t(KU));
+    }
+
+    CAPYBARA_INLINE
+    index_t skip(index_t axis, index_t steps) const {
+        return is_stored() ? 0 : segment(axis, steps);
+    }
+
+    CAPYBARA_INLINE
+    value_type load() const {
+        return is_stored() ? data_[offset_] : value_type {};
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type value) {
+        if (is_stored()) {
+            data_[offset_] = std::move(value);
+        }
+    }
+
+  private:
+    CAPYBARA_INLINE
+    bool is_stored() const {
+        return diagonal_ >= -index_t(KL) && diagonal_ <= index_t(KU);
+    }
+
+    T* data_;
+    index_t offset_ = index_t(KL);
+    index_t diagonal_ = 0;
+};
+
+template<size_t KL, size_t KU, typename T>
+struct layout_cursor<layout::banded<KL, KU>, T> {
+    using type = banded_cursor<T, KL, KU>;
+
+    CAPYBARA_INLINE
+    static type call(const layout::banded<KL, KU>& layout, T* data) {
+        return type(data);
+    }
+};
+
+// Array cursor whose innermost stride is the compile-time channel count, so
+// that loops over one channel of interleaved pixels have a constant stride
+// the compiler can vectorize (gathering every `C`-th element).
+template<typename T, size_t N, size_t C>
+struct channel_cursor {
+    channel_cursor(T* data, layout::strides_type<N> strides) :
+        data_(data),
+        strides_(strides) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (axis == index_t(N) - 1) {
+            data_ += steps * stride_t(C);
+        } else {
+            data_ += steps * strides_[axis];
+        }
+    }
+
+    CAPYBARA_INLINE
+    T load() const {
+        return *data_;
+    }
+
+    CAPYBARA_INLINE
+    void store(T value) {
+        *data_ = std::move(value);
+    }
+
+  private:
+    T* data_;
+    layout::strides_type<N> strides_;
+};
+
+template<size_t N, size_t C, typename T>
+struct layout_cursor<layout::channel_plane<N, C>, T> {
+    using type = channel_cursor<T, N, C>;
+
+    CAPYBARA_INLINE
+    static type call(const layout::channel_plane<N, C>& layout, T* data) {
+        return type(data, layout.strides());
+    }
+};
+
+// Moves along axis 0 wrap around the slots of the ring. `segment` reports
+// the distance to the wrap point, so that runs along axis 0 stay contiguous.
+template<typename T, size_t N>
+struct ring_cursor {
+    using value_type = typename std::remove_const<T>::type;
+
+    ring_cursor(
+        T* data,
+        layout::strides_type<N> strides,
+        index_t head,
+        index_t capacity) :
+        data_(data),
+        strides_(strides),
+        slot_(head),
+        capacity_(capacity) {
+        data_ += head * strides_[0];
+    }
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (axis != 0) {
+            data_ += steps * strides_[axis];
+            return;
+        }
+
+        index_t next = slot_ + steps;
+
+        if (next < 0 || next >= capacity_) {
+            next %= capacity_;
+            next = next < 0 ? next + capacity_ : next;
+        }
+
+        data_ += (next - slot_) * strides_[0];
+        slot_ = next;
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        if (axis != 0 || steps == 0) {
+            return std::numeric_limits<index_t>::max();
+        } else if (steps > 0) {
+            return (capacity_ - slot_ + steps - 1) / steps;
+        } else {
+            return slot_ / -steps + 1;
+        }
+    }
+
+    CAPYBARA_INLINE
+    value_type load() const {
+        return *data_;
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type value) {
+        *data_ = std::move(value);
+    }
+
+  private:
+    T* data_;
+    layout::strides_type<N> strides_;
+    index_t slot_;
+    index_t capacity_;
+};
+
+template<size_t N, typename T>
+struct layout_cursor<layout::ring<N>, T> {
+    using type = ring_cursor<T, N>;
+
+    CAPYBARA_INLINE
+    static type call(const layout::ring<N>& layout, T* data) {
+        return type(
+            data,
+            layout.slot_strides(),
+            layout.head(),
+            layout.capacity());
+    }
+};
+}  // namespace capybara
@@ -0,0 +1,727 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "array.h"
+#include "eval.h"
+#include "layout.h"
+#include "storage.h"
+
+namespace capybara {
+
+/// Contents of the header of a `.npy` file.
+struct npy_header {
+    char byte_order;  // '<', '>' or '|' (not applicable)
+    char kind;  // 'f', 'i', 'u' or 'b'
+    size_t item_size;
+    bool fortran_order;
+    std::vector<index_t> shape;
+    size_t data_offset;  // from the start of the `.npy` data
+};
+
+namespace npy {
+    static constexpr char magic[] = "\x93NUMPY";
+    static constexpr size_t magic_size = 6;
+
+    // Buffer size used when data has to be converted while reading.
+    static constexpr size_t chunk_size = size_t(1) << 20;
+
+    inline bool is_little_endian() {
+        uint16_t value = 1;
+        unsigned char first;
+        std::memcpy(&first, &value, 1);
+        return first == 1;
+    }
+
+    inline char native_byte_order() {
+        return is_little_endian() ? '<' : '>';
+    }
+
+    template<typename T>
+    constexpr char kind() {
+        return std::is_same<T, bool>::value ? 'b'
+            : std::is_floating_point<T>::value ? 'f'
+            : std::is_signed<T>::value ? 'i'
+            : 'u';
+    }
+
+    template<typename T>
+    std::string descr() {
+        static_assert(
+            std::is_arithmetic<T>::value,
+            "only arithmetic types can be stored in .npy files");
+        char order = sizeof(T) == 1 ? '|' : native_byte_order();
+        return std::string {order, kind<T>()} + std::to_string(sizeof(T));
+    }
+
+    // Finds `'key':` in a header dictionary and returns the position after
+    // it, with whitespace skipped.
+    inline size_t find_key(const std::string& header, const char* key) {
+        std::string needle = std::string("'") + key + "'";
+        size_t pos = header.find(needle);
+
+        if (pos == std::string::npos) {
+            throw std::runtime_error(
+                std::string("missing key in .npy header: ") + key);
+        }
+
+        pos = header.find(':', pos + needle.size());
+        if (pos == std::string::npos) {
+            throw std::runtime_error("invalid .npy header");
+        }
+
+        pos++;
+        while (pos < header.size() && header[pos] == ' ') {
+            pos++;
+        }
+
+        return pos;
+    }
+
+    inline npy_header parse_header(const std::string& text, size_t offset) {
+        npy_header header;
+        header.data_offset = offset;
+
+        // 'descr': '<f8'
+        size_t pos = find_key(text, "descr");
+        size_t end = text.find(text[pos], pos + 1);
+        if (end == std::string::npos || end - pos < 4) {
+            throw std::runtime_error("invalid dtype in .npy header");
+        }
+
+        std::string descr = text.substr(pos + 1, end - pos - 1);
+        header.byte_order = descr[0] == '=' ? native_byte_order() : descr[0];
+        header.kind = descr[1];
+        header.item_size = std::stoul(descr.substr(2));
+
+        if (std::string("<>|").find(header.byte_order) == std::string::npos
+            || std::string("fiub").find(header.kind) == std::string::npos) {
+            throw std::runtime_error("unsupported dtype: " + descr);
+        }
+
+        // 'fortran_order': False
+        pos = find_key(text, "fortran_order");
+        header.fortran_order = text.compare(pos, 4, "True") == 0;
+
+        // 'shape': (3, 4)
+        pos = find_key(text, "shape");
+        end = text.find(')', pos);
+        if (text[pos] != '(' || end == std::string::npos) {
+            throw std::runtime_error("invalid shape in .npy header");
+        }
+
+        for (pos++; pos < end;) {
+            while (pos < end && (text[pos] == ' ' || text[pos] == ',')) {
+                pos++;
+            }
+
+            if (pos < end) {
+                size_t length = 0;
+                header.shape.push_back(
+                    index_t(std::stoll(text.substr(pos, end - pos), &length)));
+                pos += length;
+            }
+        }
+
+        return header;
+    }
+
+    /// Reads the header of a `.npy` file that starts at the current position
+    /// of `stream`.
+    inline npy_header read_header(std::istream& stream) {
+        char prefix[magic_size + 2];
+        stream.read(prefix, sizeof(prefix));
+
+        if (!stream || std::memcmp(prefix, magic, magic_size) != 0) {
+            throw std::runtime_error("not a .npy file");
+        }
+
+        unsigned char major = static_cast<unsigned char>(prefix[magic_size]);
+        size_t field = major == 1 ? 2 : 4;
+        unsigned char length_bytes[4] = {0, 0, 0, 0};
+        stream.read(reinterpret_cast<char*>(length_bytes), field);
+
+        size_t length = 0;
+        for (size_t i = field; i > 0; i--) {
+            length = length * 256 + length_bytes[i - 1];
+        }
+
+        std::string text(length, ' ');
+        stream.read(&text[0], length);
+
+        if (!stream) {
+            throw std::runtime_error("truncated .npy header");
+        }
+
+        return parse_header(text, magic_size + 2 + field + length);
+    }
+
+    /// Returns the complete header (magic, version, length and dictionary)
+    /// for an array of `T` with the given shape in C order.
+    template<typename T, size_t N>
+    std::string encode_header(const dshape<N>& shape) {
+        std::string dict = "{'descr': '" + descr<T>()
+            + "', 'fortran_order': False, 'shape': (";
+
+        for (size_t i = 0; i < N; i++) {
+            dict += std::to_string(shape[i]);
+            dict += N == 1 ? "," : i + 1 < N ? ", " : "";
+        }
+
+        dict += "), }";
+
+        // Pad with spaces so the data starts at a multiple of 64 bytes
+        size_t field = dict.size() + 11 > 65535 ? 4 : 2;
+        size_t total = magic_size + 2 + field + dict.size() + 1;
+        dict.append((64 - total % 64) % 64, ' ');
+        dict += '\n';
+
+        std::string result(magic, magic_size);
+        result += char(field == 2 ? 1 : 2);
+        result += char(0);
+
+        for (size_t i = 0, n = dict.size(); i < field; i++, n /= 256) {
+            result += char(n % 256);
+        }
+
+        return result + dict;
+    }
+
+    inline void swap_bytes(char* data, size_t count, size_t item_size) {
+        for (size_t i = 0; i < count; i++) {
+            std::reverse(data + i * item_size, data + (i + 1) * item_size);
+        }
+    }
+
+    template<typename S, typename T>
+    void convert_from(const char* src, T* dst, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            S value;
+            std::memcpy(&value, src + i * sizeof(S), sizeof(S));
+            dst[i] = static_cast<T>(value);
+        }
+    }
+
+    // Converts `count` items of the dtype of `header` (in native byte
+    // order) into `T`.
+    template<typename T>
+    void convert(
+        const npy_header& header,
+        const char* src,
+        T* dst,
+        size_t count) {
+        char kind = header.kind;
+        size_t size = header.item_size;
+
+        if (kind == 'f' && size == 4) {
+            convert_from<float>(src, dst, count);
+        } else if (kind == 'f' && size == 8) {
+            convert_from<double>(src, dst, count);
+        } else if (kind == 'i' && size == 1) {
+            convert_from<int8_t>(src, dst, count);
+        } else if (kind == 'i' && size == 2) {
+            convert_from<int16_t>(src, dst, count);
+        } else if (kind == 'i' && size == 4) {
+            convert_from<int32_t>(src, dst, count);
+        } else if (kind == 'i' && size == 8) {
+            convert_from<int64_t>(src, dst, count);
+        } else if ((kind == 'u' || kind == 'b') && size == 1) {
+            convert_from<uint8_t>(src, dst, count);
+        } else if (kind == 'u' && size == 2) {
+            convert_from<uint16_t>(src, dst, count);
+        } else if (kind == 'u' && size == 4) {
+            convert_from<uint32_t>(src, dst, count);
+        } else if (kind == 'u' && size == 8) {
+            convert_from<uint64_t>(src, dst, count);
+        } else {
+            throw std::runtime_error("unsupported dtype in .npy file");
+        }
+    }
+
+    template<typename T>
+    bool is_native(const npy_header& header) {
+        bool order = header.item_size == 1 || header.byte_order == '|'
+            || header.byte_order == native_byte_order();
+        return order && header.kind == kind<T>()
+            && header.item_size == sizeof(T);
+    }
+
+    template<size_t N>
+    dshape<N> shape_of(const npy_header& header) {
+        dshape<N> shape;
+
+        if (header.shape.size() != N) {
+            throw std::runtime_error("array in .npy file has other rank");
+        }
+
+        for (size_t i = 0; i < N; i++) {
+            shape[i] = header.shape[i];
+        }
+
+        return shape;
+    }
+
+    // Reads `count` elements at the current position of `stream` into `dst`.
+    // Data in the native dtype is read with a single call, other data is
+    // read and converted one chunk at a time.
+    template<typename T>
+    void read_data(
+        std::istream& stream,
+        const npy_header& header,
+        T* dst,
+        size_t count) {
+        bool swap = header.item_size > 1 && header.byte_order != '|'
+            && header.byte_order != native_byte_order();
+
+        if (is_native<T>(header)) {
+            stream.read(reinterpret_cast<char*>(dst), count * sizeof(T));
+        } else {
+            size_t items = chunk_size / header.item_size + 1;
+            std::vector<char> buffer(items * header.item_size);
+
+            for (size_t i = 0; i < count && stream; i += items) {
+                size_t n = count - i < items ? count - i : items;
+                stream.read(buffer.data(), n * header.item_size);
+
+                if (swap) {
+                    swap_bytes(buffer.data(), n, header.item_size);
+                }
+
+                convert(header, buffer.data(), dst + i, n);
+            }
+        }
+
+        if (!stream) {
+            throw std::runtime_error("truncated .npy data");
+        }
+    }
+
+    // Reads an array whose `.npy` data starts at the current position.
+    template<typename T, size_t N>
+    array<T, N> read_array(std::istream& stream) {
+        npy_header header = read_header(stream);
+        dshape<N> shape = shape_of<N>(header);
+        array<T, N> result(shape);
+        size_t count = static_cast<size_t>(result.size());
+
+        if (!header.fortran_order || N < 2) {
+            read_data(stream, header, result.data(), count);
+        } else {
+            array_base<layout::col_major<N>, storage::heap<T>> buffer(shape);
+            read_data(stream, header, buffer.data(), count);
+            assign(result, buffer);
+        }
+
+        return result;
+    }
+
+    // Calls `fun(header, data, bytes)` with the encoded header and the raw
+    // data of `values`, which are written out as they are.
+    template<size_t N, typename S, typename F>
+    void with_data(const array_base<layout::row_major<N>, S>& values, F fun) {
+        using T = decay_t<typename S::value_type>;
+        fun(encode_header<T>(values.shape()),
+            reinterpret_cast<const char*>(values.data()),
+            static_cast<size_t>(values.size()) * sizeof(T));
+    }
+
+    // Expressions other than row-major arrays are evaluated first.
+    template<typename E, typename F>
+    void with_data(const E& expr, F fun) {
+        with_data(evaluate(expr), fun);
+    }
+
+    inline uint32_t crc32(uint32_t crc, const char* data, size_t length) {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> result;
+
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                }
+
+                result[i] = c;
+            }
+
+            return result;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++) {
+            crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF]
+                ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+
+    inline uint64_t read_le(const char* data, size_t bytes) {
+        uint64_t result = 0;
+
+        for (size_t i = bytes; i > 0; i--) {
+            result = result * 256 + static_cast<unsigned char>(data[i - 1]);
+        }
+
+        return result;
+    }
+
+    inline void write_le(std::string& out, uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++, value >>= 8) {
+            out += char(value & 0xFF);
+        }
+    }
+
+    /// Byte offset of the `.npy` data of entry `name` (without the `.npy`
+    /// suffix) in the `.npz` (zip) archive read by `stream`. Only stored
+    /// (uncompressed) entries are supported.
+    inline size_t find_entry(std::istream& stream, const std::string& name) {
+        // The end of central directory record is in the last 64 KiB
+        stream.seekg(0, std::ios::end);
+        size_t file_size = static_cast<size_t>(stream.tellg());
+        size_t tail = file_size < 65557 ? file_size : 65557;
+        std::vector<char> buffer(tail);
+        stream.seekg(static_cast<std::streamoff>(file_size - tail));
+        stream.read(buffer.data(), tail);
+
+        size_t eocd = tail;
+        for (size_t i = tail >= 22 ? tail - 22 + 1 : 0; i > 0; i--) {
+            if (read_le(&buffer[i - 1], 4) == 0x06054b50) {
+                eocd = i - 1;
+                break;
+            }
+        }
+
+        if (!stream || eocd == tail) {
+            throw std::runtime_error("not a .npz file");
+        }
+
+        size_t entries = read_le(&buffer[eocd + 10], 2);
+        size_t directory = read_le(&buffer[eocd + 16], 4);
+
+        // Archives with many or large entries use a zip64 directory record
+        if (eocd >= 20 && read_le(&buffer[eocd - 20], 4) == 0x07064b50) {
+            char record[56];
+            stream.seekg(
+                static_cast<std::streamoff>(read_le(&buffer[eocd - 12], 8)));
+            stream.read(record, sizeof(record));
+            entries = read_le(record + 32, 8);
+            directory = read_le(record + 48, 8);
+        }
+
+        std::string target = name + ".npy";
+        stream.seekg(static_cast<std::streamoff>(directory));
+
+        for (size_t e = 0; e < entries && stream; e++) {
+            char header[46];
+            stream.read(header, sizeof(header));
+
+            if (read_le(header, 4) != 0x02014b50) {
+                break;
+            }
+
+            size_t method = read_le(header + 10, 2);
+            uint64_t local = read_le(header + 42, 4);
+            std::vector<char> fields(
+                read_le(header + 28, 2) + read_le(header + 30, 2)
+                + read_le(header + 32, 2));
+            stream.read(fields.data(), fields.size());
+
+            size_t name_length = read_le(header + 28, 2);
+            if (std::string(fields.data(), name_length) != target) {
+                continue;
+            }
+
+            if (method != 0) {
+                throw std::runtime_error("compressed .npz is not supported");
+            }
+
+            // Zip64 extra field: only present values follow, in this order
+            if (local == 0xFFFFFFFF) {
+                size_t pos = name_length;
+                size_t end = pos + read_le(header + 30, 2);
+
+                while (pos + 4 <= end) {
+                    size_t id = read_le(&fields[pos], 2);
+                    size_t length = read_le(&fields[pos + 2], 2);
+
+                    if (id == 0x0001) {
+                        size_t skip = 0;
+                        skip += read_le(header + 24, 4) == 0xFFFFFFFF ? 8 : 0;
+                        skip += read_le(header + 20, 4) == 0xFFFFFFFF ? 8 : 0;
+                        local = read_le(&fields[pos + 4 + skip], 8);
+                    }
+
+                    pos += 4 + length;
+                }
+            }
+
+            char local_header[30];
+            stream.seekg(static_cast<std::streamoff>(local));
+            stream.read(local_header, sizeof(local_header));
+
+            if (!stream || read_le(local_header, 4) != 0x04034b50) {
+                throw std::runtime_error("corrupt .npz file");
+            }
+
+            return local + 30 + read_le(local_header + 26, 2)
+                + read_le(local_header + 28, 2);
+        }
+
+        throw std::runtime_error("no entry named " + name + " in .npz file");
+    }
+
+    inline std::ifstream open_input(const std::string& path) {
+        std::ifstream stream(path, std::ios::binary);
+
+        if (!stream) {
+            throw std::runtime_error("cannot open file: " + path);
+        }
+
+        return stream;
+    }
+}  // namespace npy
+
+template<typename T, size_t N>
+using npy_map_type = array_base<layout::strided<N>, storage::mmap<T>>;
+
+/// Reads the array stored in the `.npy` file `path`. Data is converted to
+/// `T` and to native byte order if needed; Fortran-ordered data is
+/// transposed into the row-major result.
+template<typename T, size_t N>
+array<T, N> load_npy(const std::string& path) {
+    std::ifstream stream = npy::open_input(path);
+    return npy::read_array<T, N>(stream);
+}
+
+/// Maps the `.npy` file `path` into memory without reading it. The file
+/// must hold elements of type `T` in native byte order; both C and Fortran
+/// order are mapped as they are. Use `T = const U` for a read-only mapping.
+template<typename T, size_t N>
+npy_map_type<T, N> map_npy(
+    const std::string& path,
+    storage::mmap_advice advice = storage::mmap_advice::normal,
+    size_t offset = 0) {
+    using element_type = typename std::remove_const<T>::type;
+    std::ifstream stream = npy::open_input(path);
+    stream.seekg(static_cast<std::streamoff>(offset));
+    npy_header header = npy::read_header(stream);
+
+    if (!npy::is_native<element_type>(header)) {
+        throw std::runtime_error("cannot map .npy file with other dtype");
+    }
+
+    if ((offset + header.data_offset) % alignof(element_type) != 0) {
+        throw std::runtime_error("cannot map unaligned .npy data");
+    }
+
+    dshape<N> shape = npy::shape_of<N>(header);
+    layout::strides_type<N> strides = header.fortran_order
+        ? layout::col_major<N>(shape).strides()
+        : layout::row_major<N>(shape).strides();
+
+    return {
+        layout::strided<N>(shape, strides),
+        storage::mmap<T>(path, offset + header.data_offset, advice)};
+}
+
+/// Writes `expr` to the `.npy` file `path` in C order. Row-major arrays are
+/// written directly, other expressions are evaluated first.
+template<typename E>
+void save_npy(const std::string& path, const E& expr) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+
+    if (!stream) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+
+    auto write = [&](const std::string& header, const char* data, size_t n) {
+        stream << header;
+        stream.write(data, static_cast<std::streamsize>(n));
+    };
+
+    npy::with_data(expr, write);
+
+    if (!stream) {
+        throw std::runtime_error("cannot write file: " + path);
+    }
+}
+
+/// Reads entry `name` of the uncompressed `.npz` archive `path`.
+template<typename T, size_t N>
+array<T, N> load_npz(const std::string& path, const std::string& name) {
+    std::ifstream stream = npy::open_input(path);
+    size_t offset = npy::find_entry(stream, name);
+    stream.seekg(static_cast<std::streamoff>(offset));
+    return npy::read_array<T, N>(stream);
+}
+
+/// Maps entry `name` of the uncompressed `.npz` archive `path` into memory,
+/// see `map_npy`. Entries written by `npz_writer` are aligned for this;
+/// other archives may not be, in which case this throws.
+template<typename T, size_t N>
+npy_map_type<T, N> map_npz(
+    const std::string& path,
+    const std::string& name,
+    storage::mmap_advice advice = storage::mmap_advice::normal) {
+    std::ifstream stream = npy::open_input(path);
+    size_t offset = npy::find_entry(stream, name);
+    return map_npy<T, N>(path, advice, offset);
+}
+
+/// Writes an uncompressed `.npz` archive, one array at a time. The archive
+/// is complete once `close` is called (or the writer is destroyed). Without
+/// zip64 records, an archive holds at most 65535 entries and 4 GiB; `add`
+/// throws beyond that and leaves the entries added so far intact.
+struct npz_writer {
+    explicit npz_writer(const std::string& path) :
+        stream_(path, std::ios::binary | std::ios::trunc) {
+        if (!stream_) {
+            throw std::runtime_error("cannot open file: " + path);
+        }
+    }
+
+    npz_writer(const npz_writer&) = delete;
+    npz_writer& operator=(const npz_writer&) = delete;
+
+    ~npz_writer() {
+        try {
+            close();
+        } catch (...) {
+            // Errors are reported by an explicit call to `close`
+        }
+    }
+
+    /// Adds `expr` as entry `name`, readable by numpy as `archive[name]`.
+    template<typename E>
+    void add(const std::string& name, const E& expr) {
+        auto write = [&](const std::string& header, const char* p, size_t n) {
+            add_file(name + ".npy", header, p, n);
+        };
+
+        npy::with_data(expr, write);
+    }
+
+    void close() {
+        if (!stream_.is_open()) {
+            return;
+        }
+
+        std::string directory;
+        for (const entry& e : entries_) {
+            npy::write_le(directory, 0x02014b50, 4);
+            npy::write_le(directory, 20, 2);  // made by
+            directory += header_fields(e);
+            npy::write_le(directory, 0, 2);  // comment length
+            npy::write_le(directory, 0, 2);  // disk number
+            npy::write_le(directory, 0, 2);  // internal attributes
+            npy::write_le(directory, 0, 4);  // external attributes
+            npy::write_le(directory, e.offset, 4);
+            directory += e.name;
+        }
+
+        uint64_t offset = static_cast<uint64_t>(stream_.tellp());
+        if (offset >= max_offset || directory.size() >= max_offset) {
+            throw std::runtime_error(".npz files over 4 GiB are not supported");
+        }
+
+        std::string end;
+        npy::write_le(end, 0x06054b50, 4);
+        npy::write_le(end, 0, 4);  // disk numbers
+        npy::write_le(end, entries_.size(), 2);
+        npy::write_le(end, entries_.size(), 2);
+        npy::write_le(end, directory.size(), 4);
+        npy::write_le(end, offset, 4);
+        npy::write_le(end, 0, 2);  // comment length
+
+        stream_ << directory << end;
+        stream_.close();
+
+        if (!stream_) {
+            throw std::runtime_error("cannot write .npz file");
+        }
+    }
+
+  private:
+    // Limits of the fields of a ZIP archive without zip64 records.
+    static constexpr uint64_t max_offset = 0xFFFFFFFF;
+    static constexpr size_t max_entries = 0xFFFF;
+    static constexpr size_t max_name = 0xFFFF;
+
+    struct entry {
+        std::string name;
+        uint32_t crc;
+        uint64_t size;
+        uint64_t offset;
+    };
+
+    // Fields shared by the local and central headers, from "version needed"
+    // up to and including the extra field length.
+    static std::string header_fields(const entry& e, size_t extra = 0) {
+        std::string out;
+        npy::write_le(out, 20, 2);  // version needed
+        npy::write_le(out, 0, 2);  // flags
+        npy::write_le(out, 0, 2);  // method: stored
+        npy::write_le(out, 0, 2);  // time
+        npy::write_le(out, 0x21, 2);  // date: 1980-01-01
+        npy::write_le(out, e.crc, 4);
+        npy::write_le(out, e.size, 4);
+        npy::write_le(out, e.size, 4);
+        npy::write_le(out, e.name.size(), 2);
+        npy::write_le(out, extra, 2);  // extra field length
+        return out;
+    }
+
+    void add_file(
+        const std::string& name,
+        const std::string& header,
+        const char* data,
+        size_t bytes) {
+        uint64_t offset = static_cast<uint64_t>(stream_.tellp());
+        uint64_t size = header.size() + bytes;
+
+        // Checked before anything is written, so that the archive stays
+        // valid and can still be closed
+        if (entries_.size() >= max_entries) {
+            throw std::runtime_error(".npz files over 65535 entries are "
+                                     "not supported");
+        }
+
+        if (name.size() > max_name) {
+            throw std::runtime_error("name of .npz entry is too long");
+        }
+
+        uint32_t crc = npy::crc32(0, header.data(), header.size());
+        entry e {name, npy::crc32(crc, data, bytes), size, offset};
+
+        // Pad the local header with an extra field so that the data is
+        // aligned to 64 bytes and the entry can be mapped by `map_npz`.
+        size_t end = static_cast<size_t>(offset) + 30 + name.size() + 4;
+        size_t padding = (64 - end % 64) % 64;
+
+        std::string local;
+        npy::write_le(local, 0x04034b50, 4);
+        local += header_fields(e, 4 + padding);
+        local += name;
+        npy::write_le(local, 0xCA9B, 2);  // unregistered id, ignored
+        npy::write_le(local, padding, 2);
+        local.append(padding, '\0');
+
+        if (offset + local.size() + size >= max_offset) {
+            throw std::runtime_error(".npz files over 4 GiB are not supported");
+        }
+
+        stream_ << local << header;
+        stream_.write(data, static_cast<std::streamsize>(bytes));
+        entries_.push_back(e);
+    }
+
+    std::ofstream stream_;
+    std::vector<entry> entries_;
+};
+
+}  // namespace capybara
@@ -0,0 +1,291 @@
+#pragma once
+
+#include "expr.h"
+#include "nullary.h"
+
+namespace capybara {
+template<typename C, size_t N>
+struct pad_cursor;
+
+template<typename E>
+struct pad_expr;
+
+enum struct pad_mode {
+    constant,  // fill the border with a fixed value
+    edge,  // repeat the first/last element
+    reflect,  // mirror around the first/last element (not repeated)
+};
+
+/// Maps position `i` of a padded axis onto `[0, n)` of the operand.
+CAPYBARA_INLINE
+index_t pad_index(index_t i, index_t n, pad_mode mode) {
+    if (CAPYBARA_LIKELY(i >= 0 && i < n)) {
+        return i;
+    }
+
+    if (mode == pad_mode::reflect && n > 1) {
+        index_t period = 2 * (n - 1);
+        i %= period;
+        i = i < 0 ? i + period : i;
+        return i < n ? i : period - i;
+    }
+
+    return i < 0 || n == 0 ? 0 : n - 1;
+}
+
+template<typename E>
+struct expr_traits<pad_expr<E>> {
+    static constexpr size_t rank = expr_rank<E>;
+    using value_type = decay_t<expr_value_type<E>>;
+    static constexpr bool is_writable = false;
+    static constexpr bool is_view = false;
+};
+
+template<typename E, typename D>
+struct expr_cursor<const pad_expr<E>, D> {
+    static constexpr size_t rank = expr_rank<E>;
+    using type = pad_cursor<expr_cursor_type<const E, D>, rank>;
+
+    CAPYBARA_INLINE
+    static type call(const pad_expr<E>& expr, dshape<rank> shape, D device) {
+        assert_broadcastable(expr.shape(), shape);
+        const E& operand = expr.operand();
+        dshape<rank> lengths = operand.shape();
+        std::array<bool, rank> broadcast;
+
+        for (size_t i = 0; i < rank; i++) {
+            broadcast[i] = shape[i] != expr.dimension(i);
+        }
+
+        return type(
+            operand.cursor(lengths, device),
+            lengths,
+            expr.before(),
+            broadcast,
+            expr.mode(),
+            expr.value());
+    }
+};
+
+/// Pads every axis of an expression with `before[i]` elements at the start
+/// and `after[i]` elements at the end. Border values are computed on the fly.
+template<typename E>
+struct pad_expr: expr<pad_expr<E>> {
+    using base_type = expr<pad_expr<E>>;
+    using typename base_type::shape_type;
+    using typename base_type::value_type;
+
+    pad_expr(
+        E expr,
+        shape_type before,
+        shape_type after,
+        pad_mode mode,
+        value_type value) :
+        expr_(std::move(expr)),
+        before_(before),
+        after_(after),
+        mode_(mode),
+        value_(std::move(value)) {
+        for (size_t i = 0; i < expr_rank<E>; i++) {
+            if (before_[i] < 0 || after_[i] < 0) {
+                throw std::runtime_error("invalid padding width");
+            }
+
+            bool padded = before_[i] > 0 || after_[i] > 0;
+            if (padded && mode != pad_mode::constant
+                && expr_.dimension(i) == 0) {
+                throw std::runtime_error("cannot pad empty axis");
+            }
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t dimension_impl(index_t axis) const {
+        return before_[axis] + expr_.dimension(axis) + after_[axis];
+    }
+
+    CAPYBARA_INLINE
+    const shape_type& before() const {
+        return before_;
+    }
+
+    CAPYBARA_INLINE
+    pad_mode mode() const {
+        return mode_;
+    }
+
+    CAPYBARA_INLINE
+    const value_type& value() const {
+        return value_;
+    }
+
+    CAPYBARA_INLINE
+    const E& operand() const {
+        return expr_;
+    }
+
+  private:
+    E expr_;
+    shape_type before_;
+    shape_type after_;
+    pad_mode mode_;
+    value_type value_;
+};
+
+// Every axis is made up of three regions: the leading border, the interior
+// and the trailing border. `segment` reports the distance to the next region,
+// and in the interior `run` hands out the operand's own cursor, so that the
+// evaluator runs the interior without touching the border logic.
+template<typename C, size_t N>
+struct pad_cursor {
+    using value_type = decay_t<decltype(std::declval<C>().load())>;
+
+    pad_cursor(
+        C cursor,
+        dshape<N> lengths,
+        dshape<N> before,
+        std::array<bool, N> broadcast,
+        pad_mode mode,
+        value_type value) :
+        cursor_(std::move(cursor)),
+        lengths_(lengths),
+        before_(before),
+        broadcast_(broadcast),
+        mode_(mode),
+        value_(std::move(value)) {
+        for (size_t i = 0; i < N; i++) {
+            positions_[i] = 0;
+            indices_[i] = 0;
+            outside_axes_[i] = false;
+            move(i, -before_[i]);
+        }
+    }
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        if (broadcast_[axis]) {
+            return;
+        }
+
+        positions_[axis] += steps;
+        move(axis, positions_[axis] - before_[axis]);
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        if (broadcast_[axis]) {
+            return max_position;
+        }
+
+        index_t pos = positions_[axis];
+        index_t lo = before_[axis];
+        index_t hi = lo + lengths_[axis];
+        bool inside = pos >= lo && pos < hi;
+        index_t n = max_position;
+
+        if (steps > 0 && pos < hi) {
+            index_t end = pos < lo ? lo : hi;
+            n = (end - pos + steps - 1) / steps;
+        } else if (steps < 0 && pos >= lo) {
+            index_t begin = pos >= hi ? hi : lo;
+            n = (pos - begin) / -steps + 1;
+        }
+
+        if (inside || mode_ == pad_mode::reflect) {
+            index_t m = cursor_segment<C>::call(
+                cursor_,
+                axis,
+                inside ? steps : -steps);
+            n = m < n ? m : n;
+        }
+
+        return n;
+    }
+
+    // Constant borders along other axes replace every value, so the operand
+    // is only used directly if the position is inside on every axis.
+    CAPYBARA_INLINE
+    bool has_run(index_t axis) const {
+        index_t pos = positions_[axis] - before_[axis];
+        bool inside = !broadcast_[axis] && pos >= 0 && pos < lengths_[axis];
+        bool filled = mode_ == pad_mode::constant && outside_ > 0;
+
+        return inside && !filled && cursor_run<C>::available(cursor_, axis);
+    }
+
+    CAPYBARA_INLINE
+    cursor_run_type<C> run(index_t axis) const {
+        return cursor_run<C>::call(cursor_, axis);
+    }
+
+    CAPYBARA_INLINE
+    value_type load() {
+        if (mode_ == pad_mode::constant && outside_ > 0) {
+            return value_;
+        }
+
+        return cursor_.load();
+    }
+
+  private:
+    static constexpr index_t max_position =
+        std::numeric_limits<index_t>::max();
+
+    CAPYBARA_INLINE
+    void move(index_t axis, index_t i) {
+        index_t n = lengths_[axis];
+        index_t next = pad_index(i, n, mode_);
+        bool outside = i < 0 || i >= n;
+
+        if (next != indices_[axis]) {
+            cursor_.advance(axis, next - indices_[axis]);
+            indices_[axis] = next;
+        }
+
+        outside_ += index_t(outside) - index_t(outside_axes_[axis]);
+        outside_axes_[axis] = outside;
+    }
+
+    C cursor_;
+    dshape<N> lengths_;
+    dshape<N> before_;
+    dshape<N> positions_;
+    dshape<N> indices_;
+    std::array<bool, N> broadcast_;
+    std::array<bool, N> outside_axes_;
+    index_t outside_ = 0;
+    pad_mode mode_;
+    value_type value_;
+};
+
+template<typename E>
+using pad_expr_type = pad_expr<into_expr_type<E>>;
+
+/// Pads `before[i]` elements at the start and `after[i]` elements at the end
+/// of every axis `i`. For `pad_mode::constant` the border is set to `value`.
+template<typename E>
+pad_expr_type<E> pad(
+    E&& expr,
+    dshape<expr_rank<E>> before,
+    dshape<expr_rank<E>> after,
+    pad_mode mode = pad_mode::constant,
+    expr_value_type<pad_expr_type<E>> value = {}) {
+    return {
+        into_expr(std::forward<E>(expr)),
+        before,
+        after,
+        mode,
+        std::move(value)};
+}
+
+/// Pads `widths[i]` elements on both sides of every axis `i`.
+template<typename E>
+pad_expr_type<E> pad(
+    E&& expr,
+    dshape<expr_rank<E>> widths,
+    pad_mode mode = pad_mode::constant,
+    expr_value_type<pad_expr_type<E>> value = {}) {
+    return pad(std::forward<E>(expr), widths, widths, mode, std::move(value));
+}
+
+}  // namespace capybara
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "array.h"
+#include "layout.h"
+
+namespace capybara {
+
+template<size_t N, typename S>
+using ring_array_type = array_base<layout::ring<N>, S>;
+
+template<typename T, size_t N>
+using ring_array = ring_array_type<N, storage::heap<T>>;
+
+/// Adds `row`, which has the shape of axes `1..N`, as the newest row of the
+/// window. Once the window holds `capacity` rows, the oldest row is dropped.
+/// Costs O(row): no other rows are moved.
+template<size_t N, typename S, typename E>
+void push(ring_array_type<N, S>& ring, E&& row) {
+    using value_type = typename S::value_type;
+    auto source = into_expr<N - 1>(std::forward<E>(row));
+    dshape<N - 1> shape;
+
+    for (size_t i = 1; i < N; i++) {
+        shape[i - 1] = ring.dimension(i);
+        index_t n = source.dimension(i - 1);
+
+        if (n != 1 && n != shape[i - 1]) {
+            throw std::runtime_error("cannot push row of other shape");
+        }
+    }
+
+    index_t slot = ring.layout().push();
+    stride_t offset = slot * ring.layout().slot_strides()[0];
+    array_ref<value_type, N - 1> target(
+        layout::row_major<N - 1>(shape),
+        storage::span<value_type>(ring.data() + offset));
+
+    assign(target, std::move(source));
+}
+
+}  // namespace capybara
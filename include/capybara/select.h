@@ -133,11 +133,19 @@ struct select_cursor {
 
     CAPYBARA_INLINE
     void advance(index_t axis, index_t steps) {
-        seq::for_each(operands_, [axis, steps](auto cursor) {
+        selector_.advance(axis, steps);
+        seq::for_each(operands_, [axis, steps](auto& cursor) {
             cursor.advance(axis, steps);
         });
     }
 
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        index_t n = cursor_segment<C>::call(selector_, axis, steps);
+        index_t m = tuple_segment(operands_, axis, steps);
+        return n < m ? n : m;
+    }
+
     CAPYBARA_INLINE
     value_type load() {
         return selector_helper<value_type, std::index_sequence_for<Cs...>>::load(
@@ -0,0 +1,1161 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "forwards.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define CAPYBARA_POSIX_MEMALIGN 1
+    #define CAPYBARA_POSIX_MMAP 1
+#elif defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+namespace capybara {
+
+namespace storage {
+    /// Size of a transparent huge page (2 MiB on the usual platforms).
+    static constexpr size_t huge_page_size = size_t(2) << 20;
+
+    /// Returns `bytes` of uninitialized memory aligned to `align` bytes, which
+    /// must be a power of two and a multiple of `sizeof(void*)`. Throws
+    /// `std::bad_alloc` on failure. Release with `aligned_free`.
+    inline void* aligned_alloc(size_t bytes, size_t align) {
+        void* ptr = nullptr;
+
+#if defined(CAPYBARA_POSIX_MEMALIGN)
+        if (posix_memalign(&ptr, align, bytes) != 0) {
+            ptr = nullptr;
+        }
+#elif defined(_WIN32)
+        ptr = _aligned_malloc(bytes, align);
+#else
+        // Over-allocate and keep the original pointer just before the result
+        void* raw = std::malloc(bytes + align + sizeof(void*));
+        if (raw != nullptr) {
+            size_t addr = reinterpret_cast<size_t>(raw) + sizeof(void*);
+            ptr = reinterpret_cast<void*>((addr + align - 1) & ~(align - 1));
+            static_cast<void**>(ptr)[-1] = raw;
+        }
+#endif
+
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        return ptr;
+    }
+
+    inline void aligned_free(void* ptr) {
+#if defined(CAPYBARA_POSIX_MEMALIGN)
+        std::free(ptr);
+#elif defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        if (ptr != nullptr) {
+            std::free(static_cast<void**>(ptr)[-1]);
+        }
+#endif
+    }
+
+    /// Asks the kernel to back `[ptr, ptr + bytes)` with transparent huge
+    /// pages. Only a hint: does nothing where this is not supported.
+    inline void advise_huge_pages(void* ptr, size_t bytes) {
+#if defined(MADV_HUGEPAGE)
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    // Destroys the elements and releases memory from `aligned_alloc`.
+    template<typename T>
+    struct aligned_delete {
+        size_t size = 0;
+
+        void operator()(T* ptr) const {
+            for (size_t i = size; i > 0; i--) {
+                ptr[i - 1].~T();
+            }
+
+            aligned_free(ptr);
+        }
+    };
+
+    /// Owning storage on the heap. The buffer is aligned to `Align` bytes
+    /// (at least `alignof(T)`), so rows and packets do not straddle cache
+    /// lines. With `HugePages`, buffers of at least `huge_page_size` bytes are
+    /// aligned to a huge page and advised to be backed by huge pages, which
+    /// reduces TLB misses when traversing large arrays.
+    template<typename T, size_t Align = 64, bool HugePages = false>
+    struct heap {
+        static_assert(
+            Align > 0 && (Align & (Align - 1)) == 0,
+            "alignment must be a power of two");
+        template<typename, size_t, bool>
+        friend struct heap;
+
+        using value_type = T;
+        using const_value_type = const T;
+
+        static constexpr size_t alignment = Align > alignof(T)
+            ? (Align > sizeof(void*) ? Align : sizeof(void*))
+            : (alignof(T) > sizeof(void*) ? alignof(T) : sizeof(void*));
+
+        heap() = default;
+
+        /// Takes over the buffer of `that`. The huge page policy only
+        /// affects how new buffers are allocated.
+        template<bool HP, typename = enable_t<HP != HugePages>>
+        heap(heap<T, Align, HP>&& that) noexcept :
+            data_(std::move(that.data_)),
+            size_(that.size_) {
+            that.size_ = 0;
+        }
+
+        /// Sets the number of elements to `n`. The buffer is only replaced
+        /// if `n` exceeds the capacity; the first `min(n, size())` elements
+        /// are preserved either way.
+        void resize(size_t n) {
+            if (n > capacity()) {
+                reallocate(n);
+            }
+
+            size_ = n;
+        }
+
+        /// Makes sure that the buffer can hold `n` elements without being
+        /// replaced, preserving the current elements.
+        void reserve(size_t n) {
+            if (n > capacity()) {
+                reallocate(n);
+            }
+        }
+
+        CAPYBARA_INLINE
+        T* data() {
+            return data_.get();
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return data_.get();
+        }
+
+        CAPYBARA_INLINE
+        size_t size() const {
+            return data_ ? size_ : 0;
+        }
+
+        CAPYBARA_INLINE
+        size_t capacity() const {
+            return data_ ? data_.get_deleter().size : 0;
+        }
+
+      private:
+        using buffer_type = std::unique_ptr<T, aligned_delete<T>>;
+
+        void reallocate(size_t n) {
+            size_t bytes = n * sizeof(T);
+            size_t align = alignment;
+            bool huge = HugePages && bytes >= huge_page_size;
+
+            if (huge) {
+                align = align > huge_page_size ? align : huge_page_size;
+                bytes = (bytes + huge_page_size - 1) / huge_page_size
+                    * huge_page_size;
+            }
+
+            T* ptr = static_cast<T*>(aligned_alloc(bytes, align));
+
+            if (huge) {
+                advise_huge_pages(ptr, bytes);
+            }
+
+            // Default-initialize like `new T[n]`
+            size_t i = 0;
+            try {
+                for (; i < n; i++) {
+                    new (ptr + i) T;
+                }
+            } catch (...) {
+                aligned_delete<T> {i}(ptr);
+                throw;
+            }
+
+            buffer_type buffer(ptr, aligned_delete<T> {n});
+            std::move(data(), data() + size(), ptr);
+            data_ = std::move(buffer);
+        }
+
+        buffer_type data_;
+        size_t size_ = 0;
+    };
+
+    /// Heap storage that requests transparent huge pages for large buffers.
+    template<typename T, size_t Align = 64>
+    using huge_heap = heap<T, Align, true>;
+
+    /// Source of raw memory for `storage::arena`. Implementations decide
+    /// whether `deallocate` actually releases anything.
+    struct memory_resource {
+        virtual ~memory_resource() = default;
+        virtual void* allocate(size_t bytes, size_t align) = 0;
+        virtual void deallocate(void* ptr, size_t bytes, size_t align) = 0;
+    };
+
+    /// Allocates every request directly with `aligned_alloc`.
+    struct heap_resource: memory_resource {
+        void* allocate(size_t bytes, size_t align) override {
+            return aligned_alloc(bytes, align);
+        }
+
+        void deallocate(void* ptr, size_t bytes, size_t align) override {
+            aligned_free(ptr);
+        }
+
+        static heap_resource& instance() {
+            static heap_resource resource;
+            return resource;
+        }
+    };
+
+    /// Monotonic arena: allocations bump a pointer through a buffer and are
+    /// only released all at once by `reset` or `release`. Starts from a
+    /// caller-provided buffer if given and adds blocks of at least
+    /// `block_size` bytes from the heap when that runs out. Blocks are kept
+    /// and reused after a reset. Not thread-safe: use one arena per thread.
+    struct monotonic_arena: memory_resource {
+        /// Position in the arena, see `mark` and `release`.
+        struct marker {
+            size_t block;
+            size_t offset;
+        };
+
+        explicit monotonic_arena(size_t block_size = size_t(1) << 20) :
+            block_size_(block_size) {}
+
+        monotonic_arena(
+            void* buffer,
+            size_t size,
+            size_t block_size = size_t(1) << 20) :
+            block_size_(block_size) {
+            blocks_.push_back({static_cast<char*>(buffer), size, false});
+        }
+
+        monotonic_arena(const monotonic_arena&) = delete;
+        monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+        ~monotonic_arena() override {
+            for (const block& b : blocks_) {
+                if (b.owned) {
+                    aligned_free(b.data);
+                }
+            }
+        }
+
+        void* allocate(size_t bytes, size_t align) override {
+            for (; current_.block < blocks_.size(); next_block()) {
+                const block& b = blocks_[current_.block];
+                size_t addr = reinterpret_cast<size_t>(b.data);
+                size_t begin = (addr + current_.offset + align - 1)
+                    & ~(align - 1);
+                size_t end = begin + bytes;
+
+                if (end <= addr + b.size) {
+                    current_.offset = end - addr;
+                    return reinterpret_cast<void*>(begin);
+                }
+            }
+
+            size_t size = bytes > block_size_ ? bytes : block_size_;
+            size_t block_align = align > 64 ? align : 64;
+            char* data = static_cast<char*>(aligned_alloc(size, block_align));
+            blocks_.push_back({data, size, true});
+            current_ = {blocks_.size() - 1, bytes};
+            return data;
+        }
+
+        void deallocate(void* ptr, size_t bytes, size_t align) override {
+            // Memory is released by `reset` or `release`
+        }
+
+        /// Current position, to be passed to `release` later on.
+        marker mark() const {
+            return current_;
+        }
+
+        /// Frees everything allocated after `mark` was taken.
+        void release(marker mark) {
+            current_ = mark;
+        }
+
+        /// Frees everything allocated from this arena.
+        void reset() {
+            current_ = {0, 0};
+        }
+
+      private:
+        struct block {
+            char* data;
+            size_t size;
+            bool owned;
+        };
+
+        void next_block() {
+            current_ = {current_.block + 1, 0};
+        }
+
+        std::vector<block> blocks_;
+        marker current_ = {0, 0};
+        size_t block_size_;
+    };
+
+    /// Pool that rounds every request up to a power-of-two size class and
+    /// recycles freed memory of the same class. Requests larger than
+    /// `max_size` bytes go straight to the heap. Memory is returned to the
+    /// heap when the pool is destroyed. Not thread-safe: use one pool per
+    /// thread.
+    struct pool_arena: memory_resource {
+        static constexpr size_t min_class = 6;  // 64 bytes
+        static constexpr size_t max_class = 20;  // 1 MiB
+        static constexpr size_t max_size = size_t(1) << max_class;
+
+        pool_arena() = default;
+        pool_arena(const pool_arena&) = delete;
+        pool_arena& operator=(const pool_arena&) = delete;
+
+        ~pool_arena() override {
+            for (void* ptr : owned_) {
+                aligned_free(ptr);
+            }
+        }
+
+        void* allocate(size_t bytes, size_t align) override {
+            if (bytes > max_size || align > (size_t(1) << min_class)) {
+                return aligned_alloc(bytes, align);
+            }
+
+            size_t c = size_class(bytes);
+            std::vector<void*>& list = free_[c - min_class];
+
+            if (!list.empty()) {
+                void* ptr = list.back();
+                list.pop_back();
+                return ptr;
+            }
+
+            void* ptr = aligned_alloc(size_t(1) << c, size_t(1) << min_class);
+            owned_.push_back(ptr);
+            return ptr;
+        }
+
+        void deallocate(void* ptr, size_t bytes, size_t align) override {
+            if (bytes > max_size || align > (size_t(1) << min_class)) {
+                aligned_free(ptr);
+            } else {
+                free_[size_class(bytes) - min_class].push_back(ptr);
+            }
+        }
+
+      private:
+        static size_t size_class(size_t bytes) {
+            size_t c = min_class;
+            while ((size_t(1) << c) < bytes) {
+                c++;
+            }
+
+            return c;
+        }
+
+        std::array<std::vector<void*>, max_class - min_class + 1> free_;
+        std::vector<void*> owned_;
+    };
+
+    // Per-thread resource that newly created `arena` storage draws from.
+    inline memory_resource*& current_resource_ptr() {
+        static thread_local memory_resource* resource = nullptr;
+        return resource;
+    }
+
+    /// Resource used by `arena` storage created on this thread: the one set
+    /// by the innermost `scoped_resource`, or the heap otherwise.
+    inline memory_resource& current_resource() {
+        memory_resource* resource = current_resource_ptr();
+        return resource ? *resource : heap_resource::instance();
+    }
+
+    /// Makes `resource` the current resource of this thread until the end
+    /// of the scope. Other threads, such as the workers of `fill_halo` or
+    /// `chunked_file`, keep their own current resource, so arrays they
+    /// create do not draw from `resource`. Arenas are not thread-safe, so
+    /// do not hand one to several threads.
+    struct scoped_resource {
+        explicit scoped_resource(memory_resource& resource) :
+            previous_(current_resource_ptr()) {
+            current_resource_ptr() = &resource;
+        }
+
+        scoped_resource(const scoped_resource&) = delete;
+        scoped_resource& operator=(const scoped_resource&) = delete;
+
+        ~scoped_resource() {
+            current_resource_ptr() = previous_;
+        }
+
+      private:
+        memory_resource* previous_;
+    };
+
+    /// Like `scoped_resource`, but also frees everything allocated from the
+    /// arena during the scope when it ends. Arrays using the arena must not
+    /// outlive the scope.
+    struct arena_scope: scoped_resource {
+        explicit arena_scope(monotonic_arena& arena) :
+            scoped_resource(arena),
+            arena_(arena),
+            mark_(arena.mark()) {}
+
+        ~arena_scope() {
+            arena_.release(mark_);
+        }
+
+      private:
+        monotonic_arena& arena_;
+        monotonic_arena::marker mark_;
+    };
+
+    /// Owning storage that allocates from a `memory_resource`, by default
+    /// the current resource of the thread at construction. Can be used
+    /// wherever `heap` is used, for example for short-lived temporaries.
+    /// Unless the resource is thread-safe (`heap_resource` is, the arenas
+    /// are not), only resize or destroy it on the thread that owns the
+    /// resource.
+    template<typename T, size_t Align = 64>
+    struct arena {
+        using value_type = T;
+        using const_value_type = const T;
+
+        static constexpr size_t alignment = heap<T, Align>::alignment;
+
+        arena() : resource_(&current_resource()) {}
+        explicit arena(memory_resource& resource) : resource_(&resource) {}
+
+        arena(arena&& that) noexcept :
+            resource_(that.resource_),
+            data_(that.data_),
+            size_(that.size_) {
+            that.data_ = nullptr;
+            that.size_ = 0;
+        }
+
+        arena& operator=(arena&& that) noexcept {
+            if (this != &that) {
+                release();
+                resource_ = that.resource_;
+                data_ = that.data_;
+                size_ = that.size_;
+                that.data_ = nullptr;
+                that.size_ = 0;
+            }
+
+            return *this;
+        }
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        ~arena() {
+            release();
+        }
+
+        void resize(size_t n) {
+            release();
+
+            if (n == 0) {
+                return;
+            }
+
+            T* ptr = static_cast<T*>(
+                resource_->allocate(n * sizeof(T), alignment));
+
+            size_t i = 0;
+            try {
+                for (; i < n; i++) {
+                    new (ptr + i) T;
+                }
+            } catch (...) {
+                destroy(ptr, i, n);
+                throw;
+            }
+
+            data_ = ptr;
+            size_ = n;
+        }
+
+        CAPYBARA_INLINE
+        T* data() {
+            return data_;
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return data_;
+        }
+
+        memory_resource& resource() const {
+            return *resource_;
+        }
+
+      private:
+        void destroy(T* ptr, size_t constructed, size_t n) {
+            for (size_t i = constructed; i > 0; i--) {
+                ptr[i - 1].~T();
+            }
+
+            resource_->deallocate(ptr, n * sizeof(T), alignment);
+        }
+
+        void release() {
+            if (data_ != nullptr) {
+                destroy(data_, size_, size_);
+                data_ = nullptr;
+                size_ = 0;
+            }
+        }
+
+        memory_resource* resource_;
+        T* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    template<typename T, size_t Max = 1>
+    struct stack {
+        using value_type = T;
+        using const_value_type = const T;
+
+        stack() = default;
+
+        CAPYBARA_INLINE
+        void resize(size_t n) {
+            if (n > Max) {
+                throw std::runtime_error("exceeds maximum size");
+            }
+        }
+
+        CAPYBARA_INLINE
+        T* data() {
+            return data_.data();
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return data_.data();
+        }
+
+      private:
+        std::array<T, Max> data_;
+    };
+
+    /// Keeps up to `N` elements inline, like `stack`, but moves to the heap
+    /// for larger sizes instead of throwing.
+    template<typename T, size_t N>
+    struct small {
+        using value_type = T;
+        using const_value_type = const T;
+
+        small() = default;
+
+        /// Sets the number of elements to `n`, moving them between the
+        /// inline buffer and the heap when `n` crosses `N`. The first
+        /// `min(n, size())` elements are preserved either way.
+        void resize(size_t n) {
+            bool spill = n > N;
+
+            if (spill && !spilled_) {
+                heap_.resize(n);
+                std::move(inline_.begin(), inline_.end(), heap_.data());
+            } else if (spill) {
+                heap_.resize(n);
+            } else if (spilled_) {
+                size_t kept = n < heap_.size() ? n : heap_.size();
+                std::move(heap_.data(), heap_.data() + kept, inline_.begin());
+                heap_.resize(0);
+            }
+
+            spilled_ = spill;
+        }
+
+        CAPYBARA_INLINE
+        T* data() {
+            return spilled_ ? heap_.data() : inline_.data();
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return spilled_ ? heap_.data() : inline_.data();
+        }
+
+        CAPYBARA_INLINE
+        bool is_inline() const {
+            return !spilled_;
+        }
+
+      private:
+        std::array<T, N> inline_;
+        heap<T> heap_;
+        bool spilled_ = false;
+    };
+
+    template<typename T, size_t Align>
+    struct shared_ref;
+
+    /// Reference-counted heap storage. Copies share one buffer, so passing
+    /// arrays between threads or stages is O(1). The count is atomic. Taking
+    /// a mutable pointer (non-const `data()`) first copies the buffer if it
+    /// is shared (copy-on-write), so writes never show up in other copies.
+    /// Expressions only read the buffer, see `shared_ref`.
+    template<typename T, size_t Align = 64>
+    struct shared {
+        friend struct shared_ref<T, Align>;
+
+        using value_type = T;
+        using const_value_type = const T;
+
+        shared() = default;
+
+        shared(const shared& that) noexcept : block_(that.block_) {
+            if (block_ != nullptr) {
+                block_->count.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        shared(shared&& that) noexcept : block_(that.block_) {
+            that.block_ = nullptr;
+        }
+
+        /// Takes over the buffer of `buffer` without copying it.
+        shared(heap<T, Align>&& buffer) {
+            if (buffer.size() > 0) {
+                block_ = new control(std::move(buffer));
+            }
+        }
+
+        shared& operator=(shared that) noexcept {
+            std::swap(block_, that.block_);
+            return *this;
+        }
+
+        ~shared() {
+            unref();
+        }
+
+        /// Keeps the buffer if it has the right size and is not shared,
+        /// otherwise allocates a new one.
+        void resize(size_t n) {
+            if (block_ != nullptr && block_->size == n && unique()) {
+                return;
+            }
+
+            unref();
+            block_ = n > 0 ? new control(n) : nullptr;
+        }
+
+        CAPYBARA_INLINE
+        T* data() {
+            if (block_ == nullptr) {
+                return nullptr;
+            }
+
+            if (!unique()) {
+                detach();
+            }
+
+            return block_->buffer.data();
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return block_ != nullptr ? block_->buffer.data() : nullptr;
+        }
+
+        /// True if no other copy shares the buffer, so it may be modified or
+        /// reused in place.
+        CAPYBARA_INLINE
+        bool unique() const {
+            return use_count() <= 1;
+        }
+
+        /// Moves the buffer out, leaving this storage empty. Only allowed
+        /// if the buffer is not shared.
+        heap<T, Align> take_buffer() {
+            heap<T, Align> result;
+
+            if (!unique()) {
+                throw std::runtime_error("cannot take shared buffer");
+            }
+
+            if (block_ != nullptr) {
+                result = std::move(block_->buffer);
+                unref();
+            }
+
+            return result;
+        }
+
+        CAPYBARA_INLINE
+        size_t use_count() const {
+            return block_ != nullptr
+                ? block_->count.load(std::memory_order_acquire)
+                : 0;
+        }
+
+      private:
+        struct control {
+            explicit control(size_t n) : size(n) {
+                buffer.resize(n);
+            }
+
+            explicit control(heap<T, Align>&& b) :
+                size(b.size()),
+                buffer(std::move(b)) {}
+
+            std::atomic<size_t> count {1};
+            size_t size;
+            heap<T, Align> buffer;
+        };
+
+        void detach() {
+            control* copy = new control(block_->size);
+            const T* src = block_->buffer.data();
+            std::copy(src, src + block_->size, copy->buffer.data());
+
+            unref();
+            block_ = copy;
+        }
+
+        void unref() {
+            if (block_ != nullptr
+                && block_->count.fetch_sub(1, std::memory_order_acq_rel)
+                    == 1) {
+                delete block_;
+            }
+
+            block_ = nullptr;
+        }
+
+        control* block_ = nullptr;
+    };
+
+    /// Refers to the `shared` storage of an array that is used in an
+    /// expression, like `span` does for other storage. Reading through it
+    /// never copies the buffer, even if it is shared. Writing requires a
+    /// call to `detach` first, which `assign` does for its destination (see
+    /// `expr_prepare_write`).
+    template<typename T, size_t Align = 64>
+    struct shared_ref {
+        using value_type = T;
+        using const_value_type = T;
+
+        shared_ref(shared<T, Align>& v) : owner_(&v) {}
+
+        /// The referenced buffer cannot be resized, so `n` must match it.
+        void resize(size_t n) {
+            auto* block = owner_->block_;
+
+            if (n != (block != nullptr ? block->size : 0)) {
+                throw std::runtime_error("cannot resize shared reference");
+            }
+        }
+
+        /// Copies the buffer if it is shared, so it can be written.
+        void detach() const {
+            owner_->data();
+        }
+
+        CAPYBARA_INLINE
+        T* data() const {
+            auto* block = owner_->block_;
+            return block != nullptr ? block->buffer.data() : nullptr;
+        }
+
+      private:
+        shared<T, Align>* owner_;
+    };
+
+    /// Access pattern hint for memory-mapped storage.
+    enum struct mmap_advice {
+        normal,
+        sequential,  // read ahead aggressively, drop pages after use
+        random,  // do not read ahead
+        will_need,  // start reading the whole mapping in the background
+    };
+
+    /// Storage backed by a memory-mapped file, starting `offset` bytes into
+    /// the file. `mmap<const T>` maps the file read-only; `mmap<T>` maps it
+    /// read-write and shared, so stores end up in the file, and grows the
+    /// file when resized beyond its end. Pages are loaded on first access,
+    /// so opening even a very large file is cheap.
+    template<typename T>
+    struct mmap {
+        using value_type = T;
+        using const_value_type = const T;
+        using element_type = typename std::remove_const<T>::type;
+        static constexpr bool is_writable = !std::is_const<T>::value;
+
+        static_assert(
+            std::is_trivially_copyable<element_type>::value,
+            "memory-mapped elements must be trivially copyable");
+
+        explicit mmap(
+            const std::string& path,
+            size_t offset = 0,
+            mmap_advice advice = mmap_advice::normal) :
+            offset_(offset),
+            advice_(advice) {
+#if defined(CAPYBARA_POSIX_MMAP)
+            int flags = is_writable ? O_RDWR | O_CREAT : O_RDONLY;
+            fd_ = ::open(path.c_str(), flags, 0644);
+
+            if (fd_ < 0) {
+                throw std::runtime_error("cannot open file: " + path);
+            }
+
+            struct stat info;
+            if (::fstat(fd_, &info) != 0) {
+                ::close(fd_);
+                throw std::runtime_error("cannot stat file: " + path);
+            }
+
+            try {
+                map(static_cast<size_t>(info.st_size));
+            } catch (...) {
+                ::close(fd_);
+                throw;
+            }
+#else
+            throw std::runtime_error("memory mapping is not supported");
+#endif
+        }
+
+        mmap(mmap&& that) noexcept :
+            fd_(that.fd_),
+            base_(that.base_),
+            length_(that.length_),
+            offset_(that.offset_),
+            advice_(that.advice_) {
+            that.fd_ = -1;
+            that.base_ = nullptr;
+            that.length_ = 0;
+        }
+
+        mmap& operator=(mmap&& that) noexcept {
+            std::swap(fd_, that.fd_);
+            std::swap(base_, that.base_);
+            std::swap(length_, that.length_);
+            std::swap(offset_, that.offset_);
+            std::swap(advice_, that.advice_);
+            return *this;
+        }
+
+        mmap(const mmap&) = delete;
+        mmap& operator=(const mmap&) = delete;
+
+        ~mmap() {
+#if defined(CAPYBARA_POSIX_MMAP)
+            unmap();
+
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+#endif
+        }
+
+        /// Checks that the file holds `n` elements after the offset. A
+        /// writable mapping extends the file if needed; a read-only mapping
+        /// throws instead.
+        void resize(size_t n) {
+            size_t bytes = offset_ + n * sizeof(T);
+
+            if (n == 0) {
+                return;
+            }
+
+            if (bytes <= file_size()) {
+                return;
+            }
+
+            if (!is_writable) {
+                throw std::runtime_error("file is too small for array");
+            }
+
+#if defined(CAPYBARA_POSIX_MMAP)
+            if (::ftruncate(fd_, static_cast<off_t>(bytes)) != 0) {
+                throw std::runtime_error("cannot extend file");
+            }
+
+            unmap();
+            map(bytes);
+#endif
+        }
+
+        /// Writes modified pages back to the file.
+        void flush() {
+#if defined(CAPYBARA_POSIX_MMAP)
+            if (base_ != nullptr && ::msync(base_, length_, MS_SYNC) != 0) {
+                throw std::runtime_error("cannot flush mapping");
+            }
+#endif
+        }
+
+        CAPYBARA_INLINE
+        T* data() {
+            return base_ != nullptr ? reinterpret_cast<T*>(begin()) : nullptr;
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return base_ != nullptr ? reinterpret_cast<T*>(begin()) : nullptr;
+        }
+
+        /// Number of elements in the file after the offset.
+        CAPYBARA_INLINE
+        size_t size() const {
+            size_t bytes = file_size();
+            return bytes > offset_ ? (bytes - offset_) / sizeof(T) : 0;
+        }
+
+      private:
+        // Mappings start at a page boundary at or before the offset.
+        size_t page_offset() const {
+#if defined(CAPYBARA_POSIX_MMAP)
+            size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            return offset_ / page * page;
+#else
+            return 0;
+#endif
+        }
+
+        char* begin() const {
+            return base_ + (offset_ - page_offset());
+        }
+
+        size_t file_size() const {
+            return base_ != nullptr ? page_offset() + length_ : 0;
+        }
+
+#if defined(CAPYBARA_POSIX_MMAP)
+        void map(size_t file_size) {
+            size_t start = page_offset();
+
+            if (file_size <= start) {
+                return;
+            }
+
+            int prot = is_writable ? PROT_READ | PROT_WRITE : PROT_READ;
+            size_t length = file_size - start;
+            void* ptr = ::mmap(
+                nullptr,
+                length,
+                prot,
+                MAP_SHARED,
+                fd_,
+                static_cast<off_t>(start));
+
+            if (ptr == MAP_FAILED) {
+                throw std::runtime_error("cannot map file");
+            }
+
+            base_ = static_cast<char*>(ptr);
+            length_ = length;
+            advise();
+        }
+
+        void unmap() {
+            if (base_ != nullptr) {
+                ::munmap(base_, length_);
+                base_ = nullptr;
+                length_ = 0;
+            }
+        }
+
+        void advise() {
+            int advice = MADV_NORMAL;
+
+            if (advice_ == mmap_advice::sequential) {
+                advice = MADV_SEQUENTIAL;
+            } else if (advice_ == mmap_advice::random) {
+                advice = MADV_RANDOM;
+            } else if (advice_ == mmap_advice::will_need) {
+                advice = MADV_WILLNEED;
+            }
+
+            ::madvise(base_, length_, advice);
+        }
+#endif
+
+        int fd_ = -1;
+        char* base_ = nullptr;
+        size_t length_ = 0;
+        size_t offset_ = 0;
+        mmap_advice advice_ = mmap_advice::normal;
+    };
+
+    template<typename T>
+    struct span {
+        using value_type = T;
+        using const_value_type = T;
+
+        template<size_t Max>
+        span(stack<T, Max>& v) : data_(v.data()) {}
+
+        template<size_t Align, bool HugePages>
+        span(heap<T, Align, HugePages>& v) : data_(v.data()) {}
+
+        template<size_t Align>
+        span(arena<T, Align>& v) : data_(v.data()) {}
+
+        template<size_t N>
+        span(small<T, N>& v) : data_(v.data()) {}
+
+        template<size_t Align>
+        span(shared<T, Align>& v) : data_(v.data()) {}
+
+        template<size_t Align>
+        span(const shared_ref<T, Align>& v) : data_(v.data()) {}
+
+        span(mmap<T>& v) : data_(v.data()) {}
+
+        span(T* ptr) : data_(ptr) {}
+
+        void resize(size_t n) {
+            // TODO???
+        }
+
+        CAPYBARA_INLINE
+        T* data() const {
+            return data_;
+        }
+
+      private:
+        T* data_;
+    };
+
+    template<typename T>
+    struct span<const T> {
+        using value_type = const T;
+        using const_value_type = const T;
+
+        template<size_t Max>
+        span(const stack<T, Max>& v) : data_(v.data()) {}
+
+        template<size_t Align, bool HugePages>
+        span(const heap<T, Align, HugePages>& v) : data_(v.data()) {}
+
+        template<size_t Align>
+        span(const arena<T, Align>& v) : data_(v.data()) {}
+
+        template<size_t N>
+        span(const small<T, N>& v) : data_(v.data()) {}
+
+        template<size_t Align>
+        span(const shared<T, Align>& v) : data_(v.data()) {}
+
+        template<size_t Align>
+        span(const shared_ref<T, Align>& v) : data_(v.data()) {}
+
+        span(const mmap<T>& v) : data_(v.data()) {}
+
+        span(const mmap<const T>& v) : data_(v.data()) {}
+
+        span(const T* ptr) : data_(ptr) {}
+
+        void resize(size_t n) {
+            // TODO???
+        }
+
+        CAPYBARA_INLINE
+        const T* data() const {
+            return data_;
+        }
+
+      private:
+        const T* data_;
+    };
+
+    /// Owning storage of another kind that was moved into an expression.
+    /// It is kept behind a shared pointer, so that the expression can be
+    /// copied like any other; copies refer to the same elements.
+    template<typename S>
+    struct owned {
+        using value_type = typename S::value_type;
+        using const_value_type = typename S::const_value_type;
+
+        owned(S&& storage) :
+            storage_(std::make_shared<S>(std::move(storage))) {}
+
+        void resize(size_t n) {
+            // Sized by the array that was moved in
+        }
+
+        CAPYBARA_INLINE
+        value_type* data() {
+            return storage_->data();
+        }
+
+        CAPYBARA_INLINE
+        const_value_type* data() const {
+            return static_cast<const S&>(*storage_).data();
+        }
+
+      private:
+        std::shared_ptr<S> storage_;
+    };
+
+    /// Storage of an rvalue array once it is moved into an expression. Heap
+    /// buffers, with or without huge pages, are handed to `shared` storage,
+    /// which `evaluate` can reuse for the result. Other owning storage is
+    /// wrapped in `owned`, storage that is cheap to copy is kept as it is,
+    /// and references stay references.
+    template<typename S>
+    struct expression_storage {
+        using type = owned<S>;
+    };
+
+    template<typename T, size_t Align, bool HugePages>
+    struct expression_storage<heap<T, Align, HugePages>> {
+        using type = shared<T, Align>;
+    };
+
+    template<typename T, size_t Align>
+    struct expression_storage<shared<T, Align>> {
+        using type = shared<T, Align>;
+    };
+
+    template<typename T, size_t Max>
+    struct expression_storage<stack<T, Max>> {
+        using type = stack<T, Max>;
+    };
+
+    template<typename T>
+    struct expression_storage<span<T>> {
+        using type = span<T>;
+    };
+
+    template<typename T, size_t Align>
+    struct expression_storage<shared_ref<T, Align>> {
+        using type = shared_ref<T, Align>;
+    };
+}  // namespace storage
+
+}  // namespace capybara
@@ -0,0 +1,463 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "array.h"
+#include "chunked.h"
+#include "eval.h"
+#include "view.h"
+
+namespace capybara {
+
+/// Settings for `evaluate_streaming`.
+struct stream_options {
+    index_t block_rows = 0;  // rows per block; zero derives it from `memory`
+    size_t memory = size_t(64) << 20;  // bytes for the block buffers
+    size_t threads = 1;  // threads reading and writing chunked files
+    size_t prefetch = 1;  // blocks read ahead in the background
+};
+
+/// Where `evaluate_streaming` spent its time, to tell whether it is limited
+/// by reading or by computing.
+struct stream_stats {
+    size_t blocks = 0;
+    size_t bytes_read = 0;  // from chunked files
+    double read_seconds = 0;  // reading blocks, possibly in the background
+    double wait_seconds = 0;  // waiting for blocks that were not read yet
+    double compute_seconds = 0;  // evaluating and storing blocks
+};
+
+// How `evaluate_streaming` takes a block of rows from an operand: `load`
+// reads the block into buffer `slot`, after which `block` returns it.
+// Arrays (including mapped ones) and other expressions are not buffered but
+// sliced along axis 0 without copying. Operands of a lower rank are
+// broadcast along axis 0 and passed whole.
+template<typename S, size_t N, typename = void>
+struct stream_operand {
+    stream_operand(S& source, size_t slots, size_t threads) :
+        source_(source) {}
+
+    bool has_rows(index_t rows) const {
+        return expr_rank<S> < N || into_expr(source_).dimension(0) == rows;
+    }
+
+    index_t alignment() const {
+        return 1;
+    }
+
+    size_t row_bytes() const {
+        return 0;
+    }
+
+    bool aliases(const void* dest) const {
+        return false;
+    }
+
+    void load(size_t slot, index_t begin, index_t rows) {}
+
+    decltype(auto) block(size_t slot, index_t begin, index_t rows) {
+        using is_sliced = std::integral_constant<bool, expr_rank<S> == N>;
+        return slice(begin, rows, is_sliced {});
+    }
+
+  private:
+    auto slice(index_t begin, index_t rows, std::true_type) {
+        return make_view(
+            view::slice_axis<N, index_t>(0, begin, rows),
+            source_);
+    }
+
+    S& slice(index_t begin, index_t rows, std::false_type) {
+        return source_;
+    }
+
+    S& source_;
+};
+
+// Chunked files are read block by block into a fixed set of buffers that
+// are reused for every block.
+template<typename T, size_t N>
+struct stream_operand<const chunked_file<T, N>, N> {
+    stream_operand(
+        const chunked_file<T, N>& source,
+        size_t slots,
+        size_t threads) :
+        source_(source),
+        threads_(threads),
+        buffers_(slots) {}
+
+    bool has_rows(index_t rows) const {
+        return source_.shape()[0] == rows;
+    }
+
+    index_t alignment() const {
+        return source_.chunk_shape()[0];
+    }
+
+    size_t row_bytes() const {
+        size_t bytes = sizeof(T);
+        for (size_t i = 1; i < N; i++) {
+            bytes *= size_t(source_.shape()[i]);
+        }
+
+        return bytes;
+    }
+
+    bool aliases(const void* dest) const {
+        return &source_ == dest;
+    }
+
+    void load(size_t slot, index_t begin, index_t rows) {
+        dshape<N> offset {};
+        dshape<N> extent = source_.shape();
+        offset[0] = begin;
+        extent[0] = rows;
+
+        source_.read(offset, extent, buffers_[slot], threads_);
+    }
+
+    const array<T, N>& block(size_t slot, index_t begin, index_t rows) {
+        return buffers_[slot];
+    }
+
+  private:
+    const chunked_file<T, N>& source_;
+    size_t threads_;
+    std::vector<array<T, N>> buffers_;
+};
+
+template<typename T, size_t N>
+struct stream_operand<chunked_file<T, N>, N>:
+    stream_operand<const chunked_file<T, N>, N> {
+    using stream_operand<const chunked_file<T, N>, N>::stream_operand;
+};
+
+// How `evaluate_streaming` writes a block of rows to the destination.
+// Arrays and other writable expressions are assigned through a slice.
+template<typename D, typename = void>
+struct stream_sink {
+    static constexpr size_t rank = expr_rank<D>;
+
+    static index_t rows(const D& dest) {
+        return into_expr(dest).dimension(0);
+    }
+
+    static index_t alignment(const D& dest) {
+        return 1;
+    }
+
+    static size_t row_bytes(const D& dest) {
+        auto target = into_expr(dest);
+        size_t bytes = sizeof(expr_value_type<D>);
+
+        for (size_t i = 1; i < rank; i++) {
+            bytes *= size_t(target.dimension(i));
+        }
+
+        return bytes;
+    }
+
+    template<typename E>
+    static void
+    store(D& dest, index_t begin, index_t rows, E&& block, size_t threads) {
+        assign(
+            make_view(view::slice_axis<rank, index_t>(0, begin, rows), dest),
+            std::forward<E>(block));
+    }
+};
+
+// Chunked files evaluate the block one chunk at a time, see
+// `chunked_file::write`.
+template<typename T, size_t N>
+struct stream_sink<chunked_file<T, N>> {
+    static constexpr size_t rank = N;
+
+    static index_t rows(const chunked_file<T, N>& dest) {
+        return dest.shape()[0];
+    }
+
+    static index_t alignment(const chunked_file<T, N>& dest) {
+        return dest.chunk_shape()[0];
+    }
+
+    static size_t row_bytes(const chunked_file<T, N>& dest) {
+        return 0;
+    }
+
+    template<typename E>
+    static void store(
+        chunked_file<T, N>& dest,
+        index_t begin,
+        index_t rows,
+        E&& block,
+        size_t threads) {
+        dshape<N> offset {};
+        offset[0] = begin;
+
+        auto source = into_expr<N>(std::forward<E>(block));
+        if (source.dimension(0) != rows) {
+            throw std::runtime_error("block has wrong number of rows");
+        }
+
+        dest.write(source, offset, threads);
+    }
+};
+
+// Reads every block in turn on a background thread while earlier blocks
+// are evaluated, at most `slots` blocks ahead of the evaluation.
+// `load(slot, block)` and `eval(slot, block)` do the work. Both sides block
+// when they get too far ahead of each other.
+template<typename L, typename E>
+void stream_pipeline(
+    index_t count,
+    size_t slots,
+    L load,
+    E eval,
+    stream_stats& stats) {
+    using clock = std::chrono::steady_clock;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::exception_ptr error;
+    index_t loaded = 0;
+    index_t consumed = 0;
+    bool stopped = false;
+
+    std::thread reader([&] {
+        for (index_t b = 0; b < count; b++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return stopped || b - consumed < index_t(slots);
+                });
+
+                if (stopped) {
+                    return;
+                }
+            }
+
+            std::exception_ptr failure;
+            try {
+                load(size_t(b) % slots, b);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                error = failure;
+                loaded = failure ? loaded : b + 1;
+            }
+
+            changed.notify_all();
+
+            if (failure) {
+                return;
+            }
+        }
+    });
+
+    try {
+        for (index_t b = 0; b < count; b++) {
+            auto start = clock::now();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return loaded > b || error; });
+
+                if (loaded <= b) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            stats.wait_seconds +=
+                std::chrono::duration<double>(clock::now() - start).count();
+            eval(size_t(b) % slots, b);
+
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                consumed = b + 1;
+            }
+
+            changed.notify_all();
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopped = true;
+        }
+
+        changed.notify_all();
+        reader.join();
+        throw;
+    }
+
+    reader.join();
+}
+
+template<typename D, typename F, typename Os, size_t... Is>
+stream_stats evaluate_streaming_helper(
+    D& dest,
+    const stream_options& options,
+    size_t slots,
+    F& fun,
+    Os& operands,
+    std::index_sequence<Is...>) {
+    using clock = std::chrono::steady_clock;
+    stream_stats stats;
+    index_t total = stream_sink<D>::rows(dest);
+    index_t align = stream_sink<D>::alignment(dest);
+    size_t row_bytes = 0;
+    bool aliased = false;
+
+    for (bool valid : {std::get<Is>(operands).has_rows(total)..., true}) {
+        if (!valid) {
+            throw std::runtime_error("operand has other number of rows");
+        }
+    }
+
+    for (index_t n : {std::get<Is>(operands).alignment()..., align}) {
+        align = n > align ? n : align;
+    }
+
+    for (size_t n : {std::get<Is>(operands).row_bytes()..., size_t(0)}) {
+        row_bytes += n;
+    }
+
+    for (bool same : {std::get<Is>(operands).aliases(&dest)..., false}) {
+        aliased = aliased || same;
+    }
+
+    // Without buffered operands, blocks are sized after the output and
+    // there is nothing to read ahead
+    bool buffered = row_bytes > 0;
+    if (!buffered) {
+        row_bytes = stream_sink<D>::row_bytes(dest);
+        slots = 1;
+    }
+
+    index_t block_rows = options.block_rows;
+    if (block_rows <= 0) {
+        size_t bytes = row_bytes * slots;
+        block_rows = index_t(options.memory / (bytes > 0 ? bytes : 1));
+
+        // Blocks that are a multiple of the chunk length read every chunk
+        // only once
+        if (block_rows >= align) {
+            block_rows = block_rows / align * align;
+        }
+
+        block_rows = block_rows > 0 ? block_rows : 1;
+    }
+
+    // A chunk of a file that is both read and written must not be read
+    // ahead while it is written. That can only happen if a chunk is shared
+    // by two blocks, so then every block is read just before it is used.
+    index_t dest_align = stream_sink<D>::alignment(dest);
+    if (aliased && block_rows % dest_align != 0) {
+        slots = 1;
+    }
+
+    auto rows_of = [&](index_t b) {
+        index_t begin = b * block_rows;
+        return total - begin < block_rows ? total - begin : block_rows;
+    };
+
+    auto load = [&](size_t slot, index_t b) {
+        auto start = clock::now();
+
+        (void)std::initializer_list<int> {
+            (std::get<Is>(operands).load(slot, b * block_rows, rows_of(b)),
+             0)...};
+
+        // Only touched by one thread at a time, see `stream_pipeline`
+        stats.bytes_read += row_bytes * size_t(rows_of(b));
+        stats.read_seconds +=
+            std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    auto eval = [&](size_t slot, index_t b) {
+        auto start = clock::now();
+        index_t begin = b * block_rows;
+        index_t rows = rows_of(b);
+
+        stream_sink<D>::store(
+            dest,
+            begin,
+            rows,
+            fun(std::get<Is>(operands).block(slot, begin, rows)...),
+            options.threads);
+
+        stats.blocks++;
+        stats.compute_seconds +=
+            std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    index_t count = (total + block_rows - 1) / block_rows;
+
+    if (slots > 1) {
+        stream_pipeline(count, slots, load, eval, stats);
+    } else {
+        for (index_t b = 0; b < count; b++) {
+            if (buffered) {
+                load(0, b);
+            }
+
+            eval(0, b);
+        }
+    }
+
+    return stats;
+}
+
+/// Evaluates `fun(blocks...)` over blocks of consecutive rows (positions
+/// along axis 0) and writes the results to the same rows of `dest`, where
+/// `blocks` holds those rows of every operand in `sources`. This bounds
+/// memory use for data larger than memory: chunked files are read one
+/// block at a time into buffers that are reused for every block, and
+/// mapped arrays are only touched one block at a time (map them with
+/// `mmap_advice::sequential` so that pages are dropped early). `dest` is
+/// an array, a writable expression or a chunked file.
+///
+/// While a block is evaluated, a background thread reads the next
+/// `options.prefetch` blocks of the chunked operands. The returned
+/// statistics show how long evaluation waited for those reads.
+///
+/// `dest` may also be one of `sources` to update a chunked file in place.
+/// Reading ahead is then only done if blocks are a multiple of the chunk
+/// length along axis 0, since a chunk must not be read while it is being
+/// written. Two `chunked_file` objects for the same path are not recognized
+/// as the same file and must not be combined this way.
+///
+/// For example, `evaluate_streaming(out, {}, [](const auto& a, const auto&
+/// b) { return a * b; }, x, y)` writes the product of `x` and `y` to `out`.
+template<typename D, typename F, typename... Ss>
+stream_stats evaluate_streaming(
+    D& dest,
+    stream_options options,
+    F fun,
+    Ss&... sources) {
+    constexpr size_t rank = stream_sink<D>::rank;
+    static_assert(rank > 0, "cannot stream over array without axes");
+
+    size_t slots = options.prefetch + 1;
+    std::tuple<stream_operand<Ss, rank>...> operands {
+        stream_operand<Ss, rank>(sources, slots, options.threads)...};
+
+    return evaluate_streaming_helper(
+        dest,
+        options,
+        slots,
+        fun,
+        operands,
+        std::index_sequence_for<Ss...> {});
+}
+
+}  // namespace capybara
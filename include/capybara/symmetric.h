@@ -0,0 +1,123 @@
+#pragma once
+
+#include "expr.h"
+#include "layout.h"
+
+namespace capybara {
+template<typename C>
+struct symmetric_cursor;
+
+template<typename E>
+struct symmetric_expr;
+
+template<typename E>
+struct expr_traits<symmetric_expr<E>> {
+    static_assert(expr_rank<E> == 2, "symmetric requires a matrix");
+    static constexpr size_t rank = 2;
+    using value_type = expr_value_type<E>;
+    static constexpr bool is_writable = false;
+    static constexpr bool is_view = false;
+};
+
+template<typename E, typename D>
+struct expr_cursor<const symmetric_expr<E>, D> {
+    using type = symmetric_cursor<expr_cursor_type<const E, D>>;
+
+    CAPYBARA_INLINE
+    static type call(const symmetric_expr<E>& expr, dshape<2> shape, D device) {
+        if (shape[0] != shape[1]) {
+            throw std::runtime_error("invalid shape");
+        }
+
+        return type(
+            expr.operand().cursor(shape, device),
+            expr.operand().cursor(shape, device),
+            expr.is_upper());
+    }
+};
+
+/// Square matrix of which only the lower (or upper) triangle of the operand
+/// is read; every other element is taken from its mirror image.
+template<typename E>
+struct symmetric_expr: expr<symmetric_expr<E>> {
+    symmetric_expr(E expr, bool upper) : expr_(std::move(expr)), upper_(upper) {
+        if (expr_.dimension(0) != expr_.dimension(1)) {
+            throw std::runtime_error("symmetric requires a square matrix");
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t dimension_impl(index_t axis) const {
+        return expr_.dimension(axis);
+    }
+
+    CAPYBARA_INLINE
+    bool is_upper() const {
+        return upper_;
+    }
+
+    CAPYBARA_INLINE
+    const E& operand() const {
+        return expr_;
+    }
+
+  private:
+    E expr_;
+    bool upper_;
+};
+
+// Keeps two cursors: one at `(i, j)` and one at the mirrored `(j, i)`.
+template<typename C>
+struct symmetric_cursor {
+    using value_type = decltype(std::declval<C>().load());
+
+    symmetric_cursor(C direct, C mirror, bool upper) :
+        direct_(std::move(direct)),
+        mirror_(std::move(mirror)),
+        upper_(upper) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        direct_.advance(axis, steps);
+        mirror_.advance(1 - axis, steps);
+        (axis == 0 ? row_ : col_) += steps;
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        index_t n = upper_
+            ? layout::triangle_segment<true>(row_, col_, axis, steps)
+            : layout::triangle_segment<false>(row_, col_, axis, steps);
+        index_t m = cursor_segment<C>::call(direct_, axis, steps);
+        index_t k = cursor_segment<C>::call(mirror_, 1 - axis, steps);
+
+        n = m < n ? m : n;
+        return k < n ? k : n;
+    }
+
+    CAPYBARA_INLINE
+    value_type load() {
+        bool direct = upper_ ? col_ >= row_ : col_ <= row_;
+        return direct ? direct_.load() : mirror_.load();
+    }
+
+  private:
+    C direct_;
+    C mirror_;
+    bool upper_;
+    index_t row_ = 0;
+    index_t col_ = 0;
+};
+
+template<typename E>
+using symmetric_expr_type = symmetric_expr<into_expr_type<E>>;
+
+/// Symmetric matrix built from the lower triangle of `expr`, or from the
+/// upper triangle if `upper` is set. For example, reading a packed
+/// triangular array through this view only touches stored elements.
+template<typename E>
+symmetric_expr_type<E> symmetric(E&& expr, bool upper = false) {
+    return {into_expr(std::forward<E>(expr)), upper};
+}
+
+}  // namespace capybara
@@ -1,10 +1,15 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <exception>
 #include <limits>
+#include <mutex>
 #include <ostream>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <vector>
 
 #include "defines.h"
 
@@ -229,5 +234,76 @@ namespace seq {
         });
     }
 
+    template<size_t I, size_t N, typename = void>
+    struct visit_helper {
+        template<typename T, typename F>
+        CAPYBARA_INLINE static auto call(size_t index, T& tuple, F& fun) {
+            if (index == I) {
+                return fun(std::get<I>(tuple));
+            } else {
+                return visit_helper<I + 1, N>::call(index, tuple, fun);
+            }
+        }
+    };
+
+    template<size_t I, size_t N>
+    struct visit_helper<I, N, enable_t<I + 1 == N>> {
+        template<typename T, typename F>
+        CAPYBARA_INLINE static auto call(size_t index, T& tuple, F& fun) {
+            return fun(std::get<I>(tuple));
+        }
+    };
+
+    /// Calls `fun` on the element at runtime position `index` of `tuple`.
+    /// All invocations of `fun` must have the same return type.
+    template<
+        typename T,
+        typename F,
+        size_t N = std::tuple_size<decay_t<T>>::value>
+    CAPYBARA_INLINE auto visit(T& tuple, size_t index, F fun) {
+        return visit_helper<0, N>::call(index, tuple, fun);
+    }
+
 }  // namespace seq
+
+/// Calls `fun(worker, i)` for every `i` in `0..count` on up to `threads`
+/// threads, where `worker` identifies the calling thread. Items are handed
+/// out one at a time since their cost varies. The first exception thrown by
+/// `fun` is rethrown once all threads have stopped.
+template<typename F>
+void parallel_for(index_t count, size_t threads, F fun) {
+    std::atomic<index_t> next {0};
+    std::mutex mutex;
+    std::exception_ptr error;
+
+    auto work = [&](size_t worker) {
+        for (index_t i = next++; i < count; i = next++) {
+            try {
+                fun(worker, i);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(mutex);
+                error = error ? error : std::current_exception();
+                next = count;
+            }
+        }
+    };
+
+    size_t workers = size_t(count) < threads ? size_t(count) : threads;
+    std::vector<std::thread> pool;
+
+    for (size_t worker = 1; worker < workers; worker++) {
+        pool.emplace_back(work, worker);
+    }
+
+    work(0);
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
 }  // namespace capybara
\ No newline at end of file
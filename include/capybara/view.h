@@ -50,14 +50,14 @@ namespace view {
         CAPYBARA_INLINE expr_cursor_type<const E, D>
         cursor(const E& expr, dshape<rank_output> shape, D device) const {
             if (shape[axis_] != length_ && length_ != 1) {
-                throw std::runtime_error();
+                throw std::runtime_error("invalid shape");
             }
 
             dshape<rank_input> new_shape;
-            for (size_t i = 0; i < axis_; i++) {
+            for (index_t i = 0; i < axis_; i++) {
                 new_shape[i] = shape[i];
             }
-            for (size_t i = axis_; i < rank_input; i++) {
+            for (index_t i = axis_; i < index_t(rank_input); i++) {
                 new_shape[i] = shape[i + 1];
             }
 
@@ -85,7 +85,7 @@ namespace view {
 
             if (axis < axis_) {
                 return delegate(axis);
-            } else if (axis >= axis_) {
+            } else {
                 return delegate(axis + 1_c);
             }
         }
@@ -96,7 +96,7 @@ namespace view {
 
             if (axis < axis_) {
                 return delegate(axis, 1_c);
-            } else if (axis >= axis_) {
+            } else {
                 return delegate(axis + 1_c, 1_stride);
             }
         }
@@ -111,13 +111,13 @@ namespace view {
             }
 
             dshape<rank_input> new_shape;
-            for (size_t i = 0; i < axis_; i++) {
+            for (index_t i = 0; i < axis_; i++) {
                 new_shape[i] = shape[i];
             }
 
             new_shape[axis_] = length;
 
-            for (size_t i = axis_; i < rank_input; i++) {
+            for (index_t i = axis_; i < index_t(rank_output); i++) {
                 new_shape[i + 1] = shape[i];
             }
 
@@ -271,6 +271,73 @@ namespace view {
         Stride stride_;
     };
 
+    /// Adds a trailing axis of length `window` that walks along `axis`, so
+    /// that element `(..., i, ..., j)` refers to `(..., i + j, ...)`.
+    template<size_t N, typename Axis>
+    struct sliding_window {
+        static constexpr size_t rank_input = N;
+        static constexpr size_t rank_output = N + 1;
+
+        sliding_window(Axis axis, index_t window) :
+            axis_(axis),
+            window_(window) {
+            assert_index<N>(axis);
+
+            if (window <= 0) {
+                throw std::runtime_error("invalid window size");
+            }
+        }
+
+        template<typename A, typename F>
+        CAPYBARA_INLINE index_t dimension(A axis, F delegate) const {
+            if (axis == index_t(N)) {
+                return window_;
+            } else if (axis == axis_) {
+                index_t n = delegate(axis) - window_ + 1;
+                return n > 0 ? n : 0;
+            } else {
+                return delegate(axis);
+            }
+        }
+
+        template<typename A, typename F>
+        CAPYBARA_INLINE void advance(A axis, F delegate) const {
+            using namespace literals;
+
+            if (axis == index_t(N)) {
+                delegate(axis_, 1_stride);
+            } else {
+                delegate(axis, 1_stride);
+            }
+        }
+
+        template<typename E, typename D>
+        CAPYBARA_INLINE expr_cursor_type<const E, D>
+        cursor(const E& expr, dshape<rank_output> shape, D device) const {
+            // Windows longer than the axis leave no positions, like in
+            // `dimension`, so nothing is read through the cursor
+            index_t expr_length = expr.dimension(axis_);
+            index_t positions = expr_length - window_ + 1;
+
+            if (shape[axis_] != (positions > 0 ? positions : 0)
+                || shape[N] != window_) {
+                throw std::runtime_error("invalid shape");
+            }
+
+            dshape<rank_input> new_shape;
+            for (size_t i = 0; i < rank_input; i++) {
+                new_shape[i] = shape[i];
+            }
+
+            new_shape[axis_] = expr_length;
+            return expr.cursor(new_shape, device);
+        }
+
+      private:
+        Axis axis_;
+        index_t window_;
+    };
+
     template<size_t N>
     struct diagonal {
         static constexpr size_t rank_input = N;
@@ -329,9 +396,12 @@ namespace view {
 
         template<typename A, typename F>
         CAPYBARA_INLINE void advance(A axis, F delegate) const {
+            using namespace literals;
+
             if (axis >= index_t(P)) {
                 return delegate(
-                    into_index<rank_input>(axis - const_index<P> {}));
+                    into_index<rank_input>(axis - const_index<P> {}),
+                    1_stride);
             }
         }
 
@@ -385,6 +455,13 @@ struct expr_cursor<const view_expr<V, E>, D> {
     }
 };
 
+template<typename V, typename E>
+struct expr_prepare_write<view_expr<V, E>> {
+    static void call(const view_expr<V, E>& expr) {
+        expr_prepare_write<E>::call(expr.operand());
+    }
+};
+
 template<typename V, typename E>
 struct view_expr: expr<view_expr<V, E>> {
     template<typename, typename>
@@ -440,7 +517,7 @@ struct view_expr: expr<view_expr<V, E>> {
 template<typename V, typename C>
 struct view_cursor {
     using value_type = decltype(std::declval<C>().load());
-    static constexpr size_t rank = V::input_rank;
+    static constexpr size_t rank = V::rank_input;
 
     view_cursor(V view, C cursor) :
         view_(std::move(view)),
@@ -457,6 +534,22 @@ struct view_cursor {
         });
     }
 
+    template<typename Axis, typename Steps>
+    CAPYBARA_INLINE index_t segment(Axis axis, Steps steps) const {
+        const C& cursor = cursor_;
+        index_t result = std::numeric_limits<index_t>::max();
+
+        view_.advance(axis, [&](auto new_axis, auto new_steps) {
+            index_t n = cursor_segment<C>::call(
+                cursor,
+                into_index<rank>(new_axis),
+                new_steps * steps);
+            result = n < result ? n : result;
+        });
+
+        return result;
+    }
+
     CAPYBARA_INLINE
     value_type load() {
         return cursor_.load();
@@ -477,7 +570,23 @@ using view_expr_type = view_expr<decay_t<V>, into_expr_type<E>>;
 
 template<typename V, typename E>
 view_expr_type<V, E> make_view(V&& view, E&& expr) {
-    return view_expr_type<V, E>(view, into_expr(expr));
+    return view_expr_type<V, E>(
+        std::forward<V>(view),
+        into_expr(std::forward<E>(expr)));
+}
+
+template<typename E>
+using sliding_window_type =
+    view_expr_type<view::sliding_window<expr_rank<E>, index_t>, E>;
+
+/// Returns a view of all windows of length `window` along `axis`. The windows
+/// are indexed by a new trailing axis; no data is copied. If `window` exceeds
+/// the length of `axis`, there are no windows and the view is empty.
+template<typename E>
+sliding_window_type<E> sliding_window(E&& expr, index_t window, index_t axis) {
+    return make_view(
+        view::sliding_window<expr_rank<E>, index_t>(axis, window),
+        std::forward<E>(expr));
 }
 
 }  // namespace capybara
\ No newline at end of file
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "expr.h"
+#include "nullary.h"
+
+namespace capybara {
+template<typename C, size_t N>
+struct wrap_cursor;
+
+template<typename E>
+struct wrap_expr;
+
+/// Moves `pos` by `steps` within `[0, length)`, wrapping around at the ends.
+CAPYBARA_INLINE
+index_t wrap_index(index_t pos, index_t steps, index_t length) {
+    index_t next = pos + steps;
+
+    if (next >= length) {
+        next -= length;
+
+        if (next >= length) {
+            next %= length;
+        }
+    } else if (next < 0) {
+        next += length;
+
+        if (next < 0) {
+            next = (next % length + length) % length;
+        }
+    }
+
+    return next;
+}
+
+template<typename E>
+struct expr_traits<wrap_expr<E>> {
+    static constexpr size_t rank = expr_rank<E>;
+    using value_type = expr_value_type<E>;
+    static constexpr bool is_writable = expr_traits<E>::is_writable;
+    static constexpr bool is_view = false;
+};
+
+template<typename E, typename D>
+struct expr_cursor<const wrap_expr<E>, D> {
+    static constexpr size_t rank = expr_rank<E>;
+    using type = wrap_cursor<expr_cursor_type<const E, D>, rank>;
+
+    CAPYBARA_INLINE
+    static type call(const wrap_expr<E>& expr, dshape<rank> shape, D device) {
+        assert_broadcastable(expr.shape(), shape);
+        const E& operand = expr.operand();
+        dshape<rank> lengths = operand.shape();
+
+        auto cursor = operand.cursor(lengths, device);
+        for (size_t i = 0; i < rank; i++) {
+            cursor.advance(i, expr.offset(i));
+        }
+
+        return type(std::move(cursor), lengths, expr.offsets());
+    }
+};
+
+template<typename E>
+struct expr_prepare_write<wrap_expr<E>> {
+    static void call(const wrap_expr<E>& expr) {
+        expr_prepare_write<E>::call(expr.operand());
+    }
+};
+
+/// Periodic extension of an expression: axis `i` is repeated `reps[i]` times
+/// and starts at `offset[i]` in the operand. Used by `roll` and `tile`.
+template<typename E>
+struct wrap_expr: expr<wrap_expr<E>> {
+    using base_type = expr<wrap_expr<E>>;
+    using typename base_type::shape_type;
+
+    wrap_expr(E expr, shape_type offsets, shape_type reps) :
+        expr_(std::move(expr)),
+        offsets_(offsets),
+        reps_(reps) {
+        for (size_t i = 0; i < expr_rank<E>; i++) {
+            index_t n = expr_.dimension(i);
+
+            if (reps_[i] < 0) {
+                throw std::runtime_error("invalid number of repetitions");
+            }
+
+            offsets_[i] = n > 0 ? wrap_index(0, offsets_[i], n) : 0;
+        }
+    }
+
+    CAPYBARA_INLINE
+    index_t dimension_impl(index_t axis) const {
+        return expr_.dimension(axis) * reps_[axis];
+    }
+
+    CAPYBARA_INLINE
+    index_t offset(index_t axis) const {
+        return offsets_[axis];
+    }
+
+    CAPYBARA_INLINE
+    const shape_type& offsets() const {
+        return offsets_;
+    }
+
+    CAPYBARA_INLINE
+    const E& operand() const {
+        return expr_;
+    }
+
+  private:
+    E expr_;
+    shape_type offsets_;
+    shape_type reps_;
+};
+
+template<typename C, size_t N>
+struct wrap_cursor {
+    using value_type = decltype(std::declval<C>().load());
+
+    wrap_cursor(C cursor, dshape<N> lengths, dshape<N> positions) :
+        cursor_(std::move(cursor)),
+        lengths_(lengths),
+        positions_(positions) {}
+
+    CAPYBARA_INLINE
+    void advance(index_t axis, index_t steps) {
+        index_t pos = positions_[axis];
+        index_t next = wrap_index(pos, steps, lengths_[axis]);
+
+        cursor_.advance(axis, next - pos);
+        positions_[axis] = next;
+    }
+
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        index_t pos = positions_[axis];
+        index_t n;
+
+        if (steps > 0) {
+            n = (lengths_[axis] - pos + steps - 1) / steps;
+        } else if (steps < 0) {
+            n = pos / -steps + 1;
+        } else {
+            n = std::numeric_limits<index_t>::max();
+        }
+
+        index_t m = cursor_segment<C>::call(cursor_, axis, steps);
+        return n < m ? n : m;
+    }
+
+    // Within a segment nothing wraps around, so the run is taken by the
+    // operand's own cursor and `advance` only wraps once per run.
+    CAPYBARA_INLINE
+    bool has_run(index_t axis) const {
+        return cursor_run<C>::available(cursor_, axis);
+    }
+
+    CAPYBARA_INLINE
+    cursor_run_type<C> run(index_t axis) const {
+        return cursor_run<C>::call(cursor_, axis);
+    }
+
+    CAPYBARA_INLINE
+    value_type load() {
+        return cursor_.load();
+    }
+
+    CAPYBARA_INLINE
+    void store(value_type v) {
+        cursor_.store(std::move(v));
+    }
+
+  private:
+    C cursor_;
+    dshape<N> lengths_;
+    dshape<N> positions_;
+};
+
+template<typename E>
+using wrap_expr_type = wrap_expr<into_expr_type<E>>;
+
+/// Shifts the elements of `expr` by `shift` positions along `axis`.
+/// Elements that roll beyond the last position re-appear at the first.
+template<typename E>
+wrap_expr_type<E> roll(E&& expr, index_t shift, index_t axis = 0) {
+    constexpr size_t rank = expr_rank<E>;
+    assert_index<rank>(axis);
+
+    dshape<rank> offsets;
+    dshape<rank> reps;
+    for (size_t i = 0; i < rank; i++) {
+        offsets[i] = 0;
+        reps[i] = 1;
+    }
+
+    offsets[axis] = -shift;
+    return {into_expr(std::forward<E>(expr)), offsets, reps};
+}
+
+/// Repeats `expr` `reps[i]` times along every axis `i`.
+template<typename E>
+wrap_expr_type<E> tile(E&& expr, dshape<expr_rank<E>> reps) {
+    dshape<expr_rank<E>> offsets;
+    for (size_t i = 0; i < expr_rank<E>; i++) {
+        offsets[i] = 0;
+    }
+
+    return {into_expr(std::forward<E>(expr)), offsets, reps};
+}
+
+}  // namespace capybara
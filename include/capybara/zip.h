@@ -68,6 +68,15 @@ struct apply_view_cursor<V, zip_cursor<R, Cs...>> {
     }
 };
 
+template<template<typename...> class R, typename... Es>
+struct expr_prepare_write<zip_expr<R, Es...>> {
+    static void call(const zip_expr<R, Es...>& expr) {
+        seq::for_each(expr.operands(), [](const auto& operand) {
+            expr_prepare_write<decay_t<decltype(operand)>>::call(operand);
+        });
+    }
+};
+
 template<template<typename...> class R, typename... Es>
 struct zip_expr: expr<zip_expr<R, Es...>> {
     zip_expr(Es... operands) : operands_(std::move(operands)...) {
@@ -97,11 +106,16 @@ struct zip_cursor {
 
     CAPYBARA_INLINE
     void advance(index_t axis, index_t steps) {
-        seq::for_each(operands_, [axis, steps](auto cursor) {
+        seq::for_each(operands_, [axis, steps](auto& cursor) {
             cursor.advance(axis, steps);
         });
     }
 
+    CAPYBARA_INLINE
+    index_t segment(index_t axis, index_t steps) const {
+        return tuple_segment(operands_, axis, steps);
+    }
+
     CAPYBARA_INLINE
     const std::tuple<Cs...>& operands() const {
         return operands_;
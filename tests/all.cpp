@@ -1,3 +1 @@
-#pragma once
-
-#include "capybara/defines.h"
\ No newline at end of file
+#include "capybara/defines.h"
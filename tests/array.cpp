@@ -0,0 +1,87 @@
+#include "capybara/array.h"
+#include "capybara/eval.h"
+#include "capybara/ring.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+// Rows `begin..end` of a row-major matrix with `cols` columns that holds
+// 0, 1, 2, ... in order.
+static array<int, 2> numbered_rows(index_t begin, index_t end, index_t cols) {
+    array<int, 2> result(dshape<2> {end - begin, cols});
+
+    for (index_t i = 0; i < (end - begin) * cols; i++) {
+        result.data()[i] = int(begin * cols + i);
+    }
+
+    return result;
+}
+
+template<typename E>
+static void check_numbered_rows(const E& expr) {
+    array<int, 2> result = evaluate(expr);
+
+    for (index_t i = 0; i < index_t(result.size()); i++) {
+        REQUIRE(result.data()[i] == int(i));
+    }
+}
+
+TEST_CASE("append keeps rows when capacity grows") {
+    array<int, 2> a(dshape<2> {0, 3});
+    size_t capacity = a.storage().capacity();
+    int reallocations = 0;
+
+    for (index_t i = 0; i < 100; i++) {
+        array<int, 2> row = numbered_rows(i, i + 1, 3);
+        a.append(make_view(view::remove_axis<2, index_t, index_t>(0, 0), row));
+
+        if (a.storage().capacity() != capacity) {
+            capacity = a.storage().capacity();
+            reallocations++;
+        }
+    }
+
+    REQUIRE(a.shape() == dshape<2> {100, 3});
+    REQUIRE(reallocations > 1);
+    REQUIRE(reallocations < 10);
+    check_numbered_rows(a);
+}
+
+TEST_CASE("extend with itself across a reallocation") {
+    array<int, 2> a = numbered_rows(0, 2, 4);
+
+    for (int i = 0; i < 4; i++) {
+        a.extend(a);
+    }
+
+    REQUIRE(a.shape() == dshape<2> {32, 4});
+    for (index_t i = 0; i < 32 * 4; i++) {
+        REQUIRE(a.data()[i] == int(i % 8));
+    }
+}
+
+TEST_CASE("append to padded rows") {
+    array_base<layout::padded<2, 8>, storage::heap<int>> a(dshape<2> {0, 5});
+    a.reserve(4);
+    a.extend(numbered_rows(0, 3, 5));
+    a.extend(numbered_rows(3, 23, 5));
+
+    REQUIRE(a.dimension(0) == 23);
+    check_numbered_rows(a);
+}
+
+TEST_CASE("append to a ring that has wrapped around") {
+    ring_array<int, 2> ring(layout::ring<2>(dshape<2> {0, 2}, 3));
+
+    for (index_t i = 0; i < 5; i++) {
+        array<int, 2> rows = numbered_rows(i - 2, i - 1, 2);
+        push(ring, make_view(view::remove_axis<2, index_t, index_t>(0), rows));
+    }
+
+    REQUIRE(ring.layout().head() != 0);
+    ring.extend(numbered_rows(3, 5, 2));
+
+    REQUIRE(ring.shape() == dshape<2> {5, 2});
+    REQUIRE(ring.layout().head() == 0);
+    check_numbered_rows(ring);
+}
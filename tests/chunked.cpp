@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <fstream>
+
+#include "capybara/chunked.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+namespace {
+// File in the working directory that is removed at the end of the test.
+struct temp_file {
+    explicit temp_file(const std::string& name) :
+        path("chunked_test_" + name) {}
+
+    ~temp_file() {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+}  // namespace
+
+static uint64_t file_size(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    return static_cast<uint64_t>(stream.tellg());
+}
+
+static void patch_byte(const std::string& path, size_t offset, char value) {
+    std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekp(static_cast<std::streamoff>(offset));
+    stream.put(value);
+}
+
+static array<int, 2> numbered(index_t rows, index_t cols) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = int(i * 37 % 101) - 50;
+    }
+
+    return result;
+}
+
+static void check_block(
+    const array<int, 2>& block,
+    const array<int, 2>& full,
+    dshape<2> begin) {
+    index_t cols = full.shape()[1];
+
+    for (index_t i = 0; i < block.shape()[0]; i++) {
+        for (index_t j = 0; j < block.shape()[1]; j++) {
+            int expected = full.data()[(begin[0] + i) * cols + begin[1] + j];
+            REQUIRE(block.data()[i * block.shape()[1] + j] == expected);
+        }
+    }
+}
+
+TEST_CASE("chunked file round trip with every codec") {
+    chunk_codec codecs[] = {
+        chunk_codec::none,
+        chunk_codec::shuffle_rle,
+        chunk_codec::delta_bitpack};
+
+    for (chunk_codec c : codecs) {
+        temp_file file("round_trip");
+        array<int, 2> values = numbered(10, 7);
+
+        {
+            auto out = chunked_file<int, 2>::create(
+                file.path,
+                dshape<2> {10, 7},
+                dshape<2> {4, 3},
+                c);
+            out.write(values, 2);
+        }
+
+        auto in = chunked_file<int, 2>::open(file.path);
+        REQUIRE(in.codec() == c);
+        REQUIRE(in.grid() == dshape<2> {3, 3});
+        check_block(in.read(2), values, dshape<2> {0, 0});
+        check_block(
+            in.read(dshape<2> {3, 2}, dshape<2> {5, 4}),
+            values,
+            dshape<2> {3, 2});
+
+        // The chunk at the corner is cut off at the end of the array
+        array<int, 2> corner = in.read_chunk(dshape<2> {2, 2});
+        REQUIRE(corner.shape() == dshape<2> {2, 1});
+        check_block(corner, values, dshape<2> {8, 6});
+
+        REQUIRE_THROWS(in.write_chunk(dshape<2> {0, 0}, corner));
+    }
+}
+
+TEST_CASE("chunked file reads unwritten chunks as zero") {
+    temp_file file("unwritten");
+    array<int, 2> values = numbered(4, 3);
+
+    {
+        auto out = chunked_file<int, 2>::create(
+            file.path,
+            dshape<2> {8, 6},
+            dshape<2> {4, 3},
+            chunk_codec::shuffle_rle);
+        out.write_chunk(dshape<2> {1, 1}, values);
+    }
+
+    auto in = chunked_file<int, 2>::open(file.path);
+    array<int, 2> result = in.read();
+
+    for (index_t i = 0; i < 8; i++) {
+        for (index_t j = 0; j < 6; j++) {
+            bool written = i >= 4 && j >= 3;
+            int expected = written ? values.data()[(i - 4) * 3 + j - 3] : 0;
+            REQUIRE(result.data()[i * 6 + j] == expected);
+        }
+    }
+}
+
+TEST_CASE("chunked file rejects codecs it cannot read") {
+    temp_file file("codec");
+
+    REQUIRE_THROWS(chunked_file<double, 1>::create(
+        file.path,
+        dshape<1> {8},
+        dshape<1> {4},
+        chunk_codec::delta_bitpack));
+
+    chunked_file<double, 1>::create(
+        file.path,
+        dshape<1> {8},
+        dshape<1> {4},
+        chunk_codec::shuffle_rle);
+    REQUIRE(chunked_file<double, 1>::open(file.path).codec()
+            == chunk_codec::shuffle_rle);
+
+    // Byte 12 of the header holds the codec
+    patch_byte(file.path, 12, char(chunk_codec::delta_bitpack));
+    REQUIRE_THROWS(chunked_file<double, 1>::open(file.path));
+
+    patch_byte(file.path, 12, char(3));
+    REQUIRE_THROWS(chunked_file<double, 1>::open(file.path));
+
+    // Codec bytes from 128 up are negative as `char`
+    patch_byte(file.path, 12, char(200));
+    REQUIRE_THROWS(chunked_file<double, 1>::open(file.path));
+}
+
+TEST_CASE("chunked file reuses the space of rewritten chunks") {
+    chunk_codec codecs[] = {
+        chunk_codec::shuffle_rle,
+        chunk_codec::delta_bitpack};
+
+    for (chunk_codec c : codecs) {
+        temp_file file("gaps");
+        array<int, 1> noise(dshape<1> {64});
+        array<int, 1> zeros(dshape<1> {64});
+        uint32_t state = 12345;
+
+        for (index_t i = 0; i < 64; i++) {
+            state = state * 1103515245 + 12345;
+            noise.data()[i] = int(state >> 1);
+            zeros.data()[i] = 0;
+        }
+
+        auto f = chunked_file<int, 1>::create(
+            file.path,
+            dshape<1> {128},
+            dshape<1> {64},
+            c);
+        f.write_chunk(dshape<1> {0}, noise);
+        f.write_chunk(dshape<1> {1}, noise);
+        uint64_t size = 0;
+
+        // Chunk 0 grows and shrinks again and again. Once the file is
+        // large enough for both places of the chunk, it stops growing,
+        // also when the gaps have to be found again after reopening.
+        for (int k = 0; k < 12; k++) {
+            if (k % 3 == 2) {
+                f = chunked_file<int, 1>::open(file.path, true);
+            }
+
+            f.write_chunk(dshape<1> {0}, zeros);
+            f.write_chunk(dshape<1> {0}, noise);
+            f.write_chunk(dshape<1> {0}, zeros);
+
+            if (k == 1) {
+                size = file_size(file.path);
+            } else if (k > 1) {
+                REQUIRE(file_size(file.path) == size);
+            }
+        }
+
+        auto in = chunked_file<int, 1>::open(file.path);
+        array<int, 1> first = in.read_chunk(dshape<1> {0});
+        array<int, 1> second = in.read_chunk(dshape<1> {1});
+
+        for (index_t i = 0; i < 64; i++) {
+            REQUIRE(first.data()[i] == 0);
+            REQUIRE(second.data()[i] == noise.data()[i]);
+        }
+    }
+}
@@ -0,0 +1,229 @@
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "capybara/codec.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+// Bytes of which no two neighbours are equal, so they form no runs.
+static std::string literal_bytes(size_t n) {
+    std::string result;
+
+    for (size_t i = 0; i < n; i++) {
+        result += char(i % 2 == 0 ? 'a' + i % 26 : 'A' + i % 26);
+    }
+
+    return result;
+}
+
+static std::vector<char> rle_round_trip(const std::string& input) {
+    std::vector<char> encoded;
+    codec::rle_encode(input.data(), input.size(), encoded);
+
+    std::string decoded(input.size(), '\0');
+    codec::rle_decode(
+        encoded.data(),
+        encoded.size(),
+        &decoded[0],
+        input.size());
+    REQUIRE(decoded == input);
+
+    return encoded;
+}
+
+template<typename T>
+static std::vector<char> delta_round_trip(const std::vector<T>& input) {
+    std::vector<char> encoded;
+    codec::encode(
+        chunk_codec::delta_bitpack,
+        input.data(),
+        input.size(),
+        encoded);
+
+    std::vector<T> decoded(input.size());
+    codec::decode(
+        chunk_codec::delta_bitpack,
+        encoded.data(),
+        encoded.size(),
+        decoded.data(),
+        decoded.size());
+    REQUIRE(decoded == input);
+
+    return encoded;
+}
+
+TEST_CASE("rle encodes runs at the length limits") {
+    // Runs shorter than three bytes are stored as literals
+    REQUIRE(rle_round_trip("x").size() == 2);
+    REQUIRE(rle_round_trip("xx").size() == 3);
+    REQUIRE(rle_round_trip("xxx").size() == 2);
+
+    // The longest run that fits one control byte, and one more
+    std::vector<char> longest = rle_round_trip(std::string(130, 'x'));
+    REQUIRE(longest.size() == 2);
+    REQUIRE(static_cast<unsigned char>(longest[0]) == 255);
+
+    std::vector<char> longer = rle_round_trip(std::string(131, 'x'));
+    REQUIRE(longer.size() == 4);
+    REQUIRE(longer[2] == 0);
+
+    REQUIRE(rle_round_trip(std::string(260, 'x')).size() == 4);
+    REQUIRE(rle_round_trip(std::string()).empty());
+}
+
+TEST_CASE("rle encodes literals at the length limits") {
+    std::vector<char> longest = rle_round_trip(literal_bytes(128));
+    REQUIRE(longest.size() == 129);
+    REQUIRE(longest[0] == 127);
+
+    std::vector<char> longer = rle_round_trip(literal_bytes(129));
+    REQUIRE(longer.size() == 131);
+    REQUIRE(longer[129] == 0);
+
+    // Literals around a run
+    std::string mixed = literal_bytes(128) + std::string(5, 'x')
+        + literal_bytes(129);
+    REQUIRE(rle_round_trip(mixed).size() == 129 + 2 + 131);
+}
+
+TEST_CASE("shuffle rle round trip of typed values") {
+    std::vector<int32_t> values;
+    for (int32_t i = 0; i < 1000; i++) {
+        values.push_back(i / 7 - 20);
+    }
+
+    std::vector<char> encoded;
+    codec::encode(
+        chunk_codec::shuffle_rle,
+        values.data(),
+        values.size(),
+        encoded);
+    REQUIRE(encoded.size() < values.size() * sizeof(int32_t) / 2);
+
+    std::vector<int32_t> decoded(values.size());
+    codec::decode(
+        chunk_codec::shuffle_rle,
+        encoded.data(),
+        encoded.size(),
+        decoded.data(),
+        decoded.size());
+    REQUIRE(decoded == values);
+}
+
+TEST_CASE("delta bitpack at the width limits") {
+    // Constant data needs no bits per value
+    std::vector<char> constant = delta_round_trip(std::vector<int>(100, -5));
+    REQUIRE(constant.size() == 9);
+    REQUIRE(constant[0] == 0);
+
+    // Differences that need all 64 bits
+    int64_t lo = std::numeric_limits<int64_t>::min();
+    int64_t hi = std::numeric_limits<int64_t>::max();
+    std::vector<int64_t> extremes;
+    for (int i = 0; i < 10; i++) {
+        extremes.push_back(i % 3 == 0 ? lo : i % 3 == 1 ? hi : 0);
+    }
+
+    std::vector<char> wide = delta_round_trip(extremes);
+    REQUIRE(wide[0] == 64);
+    REQUIRE(wide.size() == 9 + 9 * 8);
+
+    delta_round_trip(std::vector<int64_t> {lo, hi, lo, hi, lo});
+    delta_round_trip(std::vector<uint64_t> {0, ~uint64_t(0), 1, 0});
+
+    // Seven differences of five bits do not fill a whole word
+    std::vector<int> partial {0, 10, 20, 5, -6, 4, 14, 0};
+    std::vector<char> packed = delta_round_trip(partial);
+    REQUIRE(packed[0] == 5);
+    REQUIRE(packed.size() == 9 + 5);
+
+    delta_round_trip(std::vector<uint8_t> {255, 0, 128, 7});
+    delta_round_trip(std::vector<int16_t> {});
+    delta_round_trip(std::vector<int16_t> {-300});
+}
+
+TEST_CASE("corrupt compressed data is rejected") {
+    std::vector<char> buffer(16);
+    std::vector<char> encoded;
+
+    SECTION("rle stream ends early") {
+        codec::rle_encode(literal_bytes(10).data(), 10, encoded);
+        REQUIRE_THROWS(codec::rle_decode(encoded.data(), 5, buffer.data(), 10));
+    }
+
+    SECTION("rle stream decodes to more bytes") {
+        std::string input(16, 'x');
+        codec::rle_encode(input.data(), input.size(), encoded);
+        REQUIRE_THROWS(codec::rle_decode(
+            encoded.data(),
+            encoded.size(),
+            buffer.data(),
+            8));
+    }
+
+    SECTION("rle stream decodes to fewer bytes") {
+        std::string input(8, 'x');
+        codec::rle_encode(input.data(), input.size(), encoded);
+        REQUIRE_THROWS(codec::rle_decode(
+            encoded.data(),
+            encoded.size(),
+            buffer.data(),
+            16));
+    }
+
+    SECTION("delta header is too short") {
+        std::vector<int> values(4, 1);
+        REQUIRE_THROWS(codec::decode(
+            chunk_codec::delta_bitpack,
+            buffer.data(),
+            8,
+            values.data(),
+            values.size()));
+    }
+
+    SECTION("delta width is too large") {
+        std::vector<int> values {1, 2, 3};
+        codec::encode(chunk_codec::delta_bitpack, values.data(), 3, encoded);
+        encoded[0] = char(65);
+        REQUIRE_THROWS(codec::decode(
+            chunk_codec::delta_bitpack,
+            encoded.data(),
+            encoded.size(),
+            values.data(),
+            values.size()));
+    }
+
+    SECTION("delta bits are missing") {
+        std::vector<int> values {0, 100, -100, 50, 1000, 3};
+        codec::encode(chunk_codec::delta_bitpack, values.data(), 6, encoded);
+        REQUIRE_THROWS(codec::decode(
+            chunk_codec::delta_bitpack,
+            encoded.data(),
+            encoded.size() - 1,
+            values.data(),
+            values.size()));
+    }
+
+    SECTION("uncompressed data has other size") {
+        std::vector<int> values(4);
+        REQUIRE_THROWS(codec::decode(
+            chunk_codec::none,
+            buffer.data(),
+            buffer.size() - 1,
+            values.data(),
+            values.size()));
+    }
+
+    SECTION("delta bitpack of floating-point values") {
+        std::vector<double> values {1.0, 2.0};
+        REQUIRE_FALSE(codec::supports<double>(chunk_codec::delta_bitpack));
+        REQUIRE_THROWS(codec::encode(
+            chunk_codec::delta_bitpack,
+            values.data(),
+            values.size(),
+            encoded));
+    }
+}
@@ -0,0 +1,114 @@
+#include "capybara/array.h"
+#include "capybara/compressed.h"
+#include "capybara/eval.h"
+#include "capybara/symmetric.h"
+#include "capybara/view.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+template<typename T>
+static array<T, 2> numbered(index_t rows, index_t cols) {
+    array<T, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = T(i * 7 % 23) - T(i % 5);
+    }
+
+    return result;
+}
+
+template<typename E, typename F>
+static void check_equal(const E& lhs, const F& rhs) {
+    auto a = evaluate(lhs);
+    auto b = evaluate(rhs);
+    REQUIRE(a.shape() == b.shape());
+
+    for (index_t i = 0; i < index_t(a.size()); i++) {
+        REQUIRE(a.data()[i] == b.data()[i]);
+    }
+}
+
+TEST_CASE("compressed array round trip with every codec") {
+    array<int, 2> ints = numbered<int>(37, 11);
+    array<float, 2> floats = numbered<float>(37, 11);
+    chunk_codec codecs[] = {
+        chunk_codec::none,
+        chunk_codec::shuffle_rle,
+        chunk_codec::delta_bitpack};
+
+    for (chunk_codec codec : codecs) {
+        // Chunks of 4 rows, which do not divide the number of rows
+        auto c = compress(ints, codec, 50);
+        REQUIRE(c.codec() == codec);
+        REQUIRE(c.chunk_size() == 44);
+        REQUIRE(c.chunk_count() == 10);
+        check_equal(c, ints);
+
+        if (codec != chunk_codec::delta_bitpack) {
+            check_equal(compress(floats, codec, 50), floats);
+        }
+    }
+
+    check_equal(compress(ints, chunk_codec::delta_bitpack, 1), ints);
+    check_equal(compress(ints), ints);
+}
+
+TEST_CASE("compressed array read through views") {
+    array<int, 2> a = numbered<int>(13, 13);
+    auto c = compress(a, chunk_codec::delta_bitpack, 30);
+
+    for (index_t axis : {0, 1}) {
+        check_equal(
+            make_view(view::flip_axis<2, index_t>(axis), c),
+            make_view(view::flip_axis<2, index_t>(axis), a));
+    }
+
+    check_equal(
+        make_view(view::diagonal<2> {}, c),
+        make_view(view::diagonal<2> {}, a));
+    check_equal(sliding_window(c, 3, 0), sliding_window(a, 3, 0));
+
+    // Reading the upper triangle mirrored walks down the columns
+    check_equal(symmetric(c, true), symmetric(a, true));
+    check_equal(symmetric(c, false), symmetric(a, false));
+}
+
+TEST_CASE("compressed array assigned to blocked layouts") {
+    array<int, 2> a = numbered<int>(21, 19);
+    auto c = compress(a, chunk_codec::shuffle_rle, 60);
+
+    array_base<layout::tiled<2, 4, 8>, storage::heap<int>> tiled(a.shape());
+    assign(tiled, c);
+    check_equal(tiled, a);
+
+    array_base<layout::morton<2>, storage::heap<int>> morton(a.shape());
+    assign(morton, c);
+    check_equal(morton, a);
+
+    // The evaluator visits the chunks of the source, not the tiles of the
+    // destination.
+    auto source = c.cursor(a.shape(), device_seq {});
+    auto dest = into_expr(tiled).cursor(a.shape(), device_seq {});
+    assign_cursor<decltype(dest), decltype(source)> cursor(dest, source);
+
+    REQUIRE(source.block(0) == 3);
+    REQUIRE(source.block(1) == 19);
+    REQUIRE(cursor.block(0) == 3);
+    REQUIRE(cursor.block(1) == 19);
+}
+
+TEST_CASE("compressed array with more axes") {
+    array<int, 3> a(dshape<3> {5, 4, 3});
+    for (index_t i = 0; i < 60; i++) {
+        a.data()[i] = int(i / 3);
+    }
+
+    auto c = compress(a, chunk_codec::delta_bitpack, 30);
+    REQUIRE(c.chunk_size() == 24);
+    check_equal(c, a);
+
+    array_base<layout::morton<3>, storage::heap<int>> morton(a.shape());
+    assign(morton, c);
+    check_equal(morton, a);
+}
@@ -0,0 +1,122 @@
+#include "capybara/array.h"
+#include "capybara/concat.h"
+#include "capybara/eval.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+static array<int, 2> numbered(index_t rows, index_t cols, int base) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = base + int(i);
+    }
+
+    return result;
+}
+
+// Element `(i, j)` of `a`, `b` and `c` (2 rows each) placed side by side.
+static int side_by_side(index_t i, index_t j) {
+    if (j < 3) {
+        return int(i * 3 + j);
+    } else if (j < 4) {
+        return 100 + int(i);
+    } else {
+        return 200 + int(i * 4 + j - 4);
+    }
+}
+
+TEST_CASE("concatenate operands of unequal length along axis 1") {
+    array<int, 2> a = numbered(2, 3, 0);
+    array<int, 2> b = numbered(2, 1, 100);
+    array<int, 2> c = numbered(2, 4, 200);
+    array<int, 2> result = evaluate(concatenate(1, a, b, c));
+
+    REQUIRE(result.shape() == dshape<2> {2, 8});
+    for (index_t i = 0; i < 2; i++) {
+        for (index_t j = 0; j < 8; j++) {
+            REQUIRE(result.data()[i * 8 + j] == side_by_side(i, j));
+        }
+    }
+}
+
+TEST_CASE("concatenate operands of unequal length along axis 0") {
+    array<int, 2> a = numbered(1, 3, 0);
+    array<int, 2> b = numbered(4, 3, 100);
+    array<int, 2> result = evaluate(concatenate(0, a, b));
+
+    REQUIRE(result.shape() == dshape<2> {5, 3});
+    for (index_t j = 0; j < 3; j++) {
+        REQUIRE(result.data()[j] == int(j));
+    }
+
+    for (index_t i = 3; i < 15; i++) {
+        REQUIRE(result.data()[i] == 100 + int(i - 3));
+    }
+}
+
+TEST_CASE("read a concatenation in reverse") {
+    array<int, 2> a = numbered(2, 3, 0);
+    array<int, 2> b = numbered(2, 1, 100);
+    array<int, 2> c = numbered(2, 4, 200);
+    array<int, 2> result = evaluate(
+        make_view(view::flip_axis<2, index_t>(1), concatenate(1, a, b, c)));
+
+    for (index_t i = 0; i < 2; i++) {
+        for (index_t j = 0; j < 8; j++) {
+            REQUIRE(result.data()[i * 8 + j] == side_by_side(i, 7 - j));
+        }
+    }
+}
+
+TEST_CASE("write through a reversed concatenation") {
+    array<int, 2> a(dshape<2> {2, 3});
+    array<int, 2> b(dshape<2> {2, 1});
+    array<int, 2> c(dshape<2> {2, 4});
+    array<int, 2> source(dshape<2> {2, 8});
+
+    for (index_t i = 0; i < 2; i++) {
+        for (index_t j = 0; j < 8; j++) {
+            source.data()[i * 8 + j] = side_by_side(i, 7 - j);
+        }
+    }
+
+    assign(
+        make_view(view::flip_axis<2, index_t>(1), concatenate(1, a, b, c)),
+        source);
+
+    REQUIRE(a.data()[5] == side_by_side(1, 2));
+    REQUIRE(b.data()[0] == side_by_side(0, 3));
+    REQUIRE(b.data()[1] == side_by_side(1, 3));
+    REQUIRE(c.data()[0] == side_by_side(0, 4));
+    REQUIRE(c.data()[7] == side_by_side(1, 7));
+}
+
+TEST_CASE("stack along a new middle axis") {
+    array<int, 2> a = numbered(2, 3, 0);
+    array<int, 2> b = numbered(2, 3, 100);
+    array<int, 3> result = evaluate(stack(1, a, b));
+
+    REQUIRE(result.shape() == dshape<3> {2, 2, 3});
+    for (index_t i = 0; i < 2; i++) {
+        for (index_t k = 0; k < 2; k++) {
+            for (index_t j = 0; j < 3; j++) {
+                int expected = (k == 0 ? 0 : 100) + int(i * 3 + j);
+                REQUIRE(result.data()[(i * 2 + k) * 3 + j] == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("stack along the last axis, read in reverse") {
+    array<int, 2> a = numbered(2, 3, 0);
+    array<int, 2> b = numbered(2, 3, 100);
+    array<int, 3> result = evaluate(
+        make_view(view::flip_axis<3, index_t>(2), stack(2, a, b)));
+
+    REQUIRE(result.shape() == dshape<3> {2, 3, 2});
+    for (index_t i = 0; i < 6; i++) {
+        REQUIRE(result.data()[2 * i] == 100 + int(i));
+        REQUIRE(result.data()[2 * i + 1] == int(i));
+    }
+}
@@ -0,0 +1,113 @@
+#include "capybara/array.h"
+#include "capybara/halo.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+template<size_t N, size_t W>
+using halo_array = halo_array_type<N, W, storage::heap<int>>;
+
+// Interior element with index `index` holds `index` written in base 10.
+template<size_t N>
+static int interior_value(const dshape<N>& index) {
+    int result = 0;
+
+    for (size_t i = 0; i < N; i++) {
+        result = 10 * result + int(index[i]);
+    }
+
+    return result;
+}
+
+// Index of the interior element that the halo cell at `index` is copied
+// from, or false if the cell takes the constant value.
+template<size_t N>
+static bool
+source_index(dshape<N>& index, const dshape<N>& shape, halo_mode mode) {
+    for (size_t i = 0; i < N; i++) {
+        index_t n = shape[i];
+        index_t& k = index[i];
+
+        if (k >= 0 && k < n) {
+            continue;
+        } else if (mode == halo_mode::constant) {
+            return false;
+        } else if (mode == halo_mode::edge) {
+            k = k < 0 ? 0 : n - 1;
+        } else {
+            k = (k % n + n) % n;
+        }
+    }
+
+    return true;
+}
+
+// Fills the interior, calls `fill_halo` and checks every cell of the array,
+// halo cells on faces, edges and corners included.
+template<size_t N, size_t W>
+static void check_halo(dshape<N> shape, halo_mode mode, size_t threads) {
+    halo_array<N, W> a(shape);
+    index_t width = index_t(W);
+    dshape<N> index;
+    size_t cells = 1;
+
+    for (size_t i = 0; i < N; i++) {
+        cells *= size_t(shape[i] + 2 * width);
+    }
+
+    auto visit = [&](auto fun) {
+        for (size_t c = 0; c < cells; c++) {
+            size_t rest = c;
+            int* ptr = a.data();
+
+            for (size_t i = N; i > 0; i--) {
+                index_t extent = shape[i - 1] + 2 * width;
+                index[i - 1] = index_t(rest % size_t(extent)) - width;
+                rest /= size_t(extent);
+                ptr += index[i - 1] * a.stride(i - 1);
+            }
+
+            fun(*ptr);
+        }
+    };
+
+    visit([&](int& cell) { cell = -1; });
+    visit([&](int& cell) {
+        dshape<N> source = index;
+
+        if (source_index(source, shape, halo_mode::constant)) {
+            cell = interior_value(index);
+        }
+    });
+
+    fill_halo(a, mode, 999, threads);
+
+    visit([&](int& cell) {
+        dshape<N> source = index;
+        bool copied = source_index(source, shape, mode);
+        REQUIRE(cell == (copied ? interior_value(source) : 999));
+    });
+}
+
+TEST_CASE("fill halo of every face, edge and corner") {
+    halo_mode modes[] = {
+        halo_mode::periodic,
+        halo_mode::constant,
+        halo_mode::edge};
+
+    for (halo_mode mode : modes) {
+        for (size_t threads : {1, 3}) {
+            check_halo<1, 2>(dshape<1> {5}, mode, threads);
+            check_halo<2, 1>(dshape<2> {4, 5}, mode, threads);
+            check_halo<2, 2>(dshape<2> {3, 4}, mode, threads);
+            check_halo<3, 2>(dshape<3> {3, 2, 4}, mode, threads);
+        }
+    }
+}
+
+TEST_CASE("fill halo wider than the interior") {
+    for (size_t threads : {1, 2}) {
+        check_halo<2, 3>(dshape<2> {2, 1}, halo_mode::periodic, threads);
+        check_halo<2, 3>(dshape<2> {2, 1}, halo_mode::edge, threads);
+    }
+}
@@ -0,0 +1,130 @@
+#include <algorithm>
+
+#include "capybara/apply.h"
+#include "capybara/array.h"
+#include "capybara/eval.h"
+#include "capybara/symmetric.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+// Row-major matrix that holds 0, 1, 2, ... in order.
+static array<int, 2> numbered(index_t rows, index_t cols) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = int(i);
+    }
+
+    return result;
+}
+
+TEST_CASE("morton layout with a non-power-of-two shape") {
+    using morton_array = array_base<layout::morton<2>, storage::heap<int>>;
+
+    std::initializer_list<dshape<2>> shapes = {
+        dshape<2> {5, 7},
+        dshape<2> {13, 3},
+        dshape<2> {1, 9}};
+
+    for (dshape<2> shape : shapes) {
+        index_t rows = shape[0];
+        index_t cols = shape[1];
+        array<int, 2> source = numbered(rows, cols);
+
+        morton_array m(shape);
+        assign(m, source);
+
+        for (index_t i = 0; i < rows; i++) {
+            for (index_t j = 0; j < cols; j++) {
+                size_t offset = m.layout().offset(dshape<2> {i, j});
+                REQUIRE(m.data()[offset] == int(i * cols + j));
+            }
+        }
+
+        array<int, 2> copy = evaluate(m);
+        REQUIRE(copy.shape() == shape);
+
+        for (index_t i = 0; i < rows * cols; i++) {
+            REQUIRE(copy.data()[i] == source.data()[i]);
+        }
+    }
+}
+
+template<bool Upper>
+static void check_packed(index_t n) {
+    using packed_array =
+        array_base<layout::packed_triangular<Upper>, storage::heap<int>>;
+    array<int, 2> source = numbered(n, n);
+
+    packed_array p(dshape<2> {n, n});
+    assign(p, source);
+    REQUIRE(p.storage().size() == size_t(n * (n + 1) / 2));
+
+    array<int, 2> stored = evaluate(p);
+    array<int, 2> mirrored = evaluate(symmetric(p, Upper));
+
+    for (index_t i = 0; i < n; i++) {
+        for (index_t j = 0; j < n; j++) {
+            bool is_stored = Upper ? j >= i : j <= i;
+            int value = int(i * n + j);
+            int mirror = int(j * n + i);
+
+            REQUIRE(stored.data()[i * n + j] == (is_stored ? value : 0));
+            REQUIRE(mirrored.data()[i * n + j] == (is_stored ? value : mirror));
+        }
+    }
+}
+
+TEST_CASE("packed triangular layout read through symmetric") {
+    for (index_t n : {1, 2, 5, 8}) {
+        check_packed<false>(n);
+        check_packed<true>(n);
+    }
+}
+
+TEST_CASE("banded layout with more sub- than super-diagonals") {
+    using banded_array = array_base<layout::banded<2, 1>, storage::heap<int>>;
+    index_t rows = 6;
+    index_t cols = 8;
+    index_t width = banded_array::layout_type::width;
+    array<int, 2> source = numbered(rows, cols);
+
+    banded_array b(dshape<2> {rows, cols});
+    std::fill(b.data(), b.data() + rows * width, -1);
+
+    // Positions off the band are skipped, so the source is only read on it.
+    index_t loads = 0;
+    auto counted = map(
+        [&loads](int x) {
+            loads++;
+            return x;
+        },
+        source);
+    assign(b, counted);
+
+    index_t on_band = 0;
+    array<int, 2> result = evaluate(b);
+
+    for (index_t i = 0; i < rows; i++) {
+        for (index_t j = 0; j < cols; j++) {
+            bool is_stored = j - i >= -2 && j - i <= 1;
+            int value = int(i * cols + j);
+
+            REQUIRE(result.data()[i * cols + j] == (is_stored ? value : 0));
+            on_band += is_stored ? 1 : 0;
+        }
+    }
+
+    REQUIRE(loads == on_band);
+
+    // Slots of the first and last rows that fall outside the matrix are
+    // never written.
+    for (index_t i = 0; i < rows; i++) {
+        for (index_t k = 0; k < width; k++) {
+            index_t j = i + k - 2;
+            int expected = j >= 0 && j < cols ? int(i * cols + j) : -1;
+            REQUIRE(b.data()[i * width + k] == expected);
+        }
+    }
+}
@@ -2,3 +2,5 @@
 // Created by stijn on 5/16/22.
 //
 
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "capybara/npy.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+// File in the working directory that is removed at the end of the test.
+struct temp_file {
+    explicit temp_file(const std::string& name) : path("npy_test_" + name) {}
+
+    ~temp_file() {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+
+static array<int, 2> numbered(index_t rows, index_t cols) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = int(i);
+    }
+
+    return result;
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    return buffer.str();
+}
+
+static void write_file(const std::string& path, const std::string& content) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream << content;
+}
+
+template<typename E>
+static void check_numbered(const E& expr, index_t rows, index_t cols) {
+    array<int, 2> result = evaluate(expr);
+    REQUIRE(result.shape() == dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        REQUIRE(result.data()[i] == int(i));
+    }
+}
+
+TEST_CASE("npy round trip in C order") {
+    temp_file file("c_order.npy");
+    save_npy(file.path, numbered(3, 5));
+
+    check_numbered(load_npy<int, 2>(file.path), 3, 5);
+
+    // Converted to another dtype while reading
+    array<double, 2> converted = load_npy<double, 2>(file.path);
+    REQUIRE(converted.data()[14] == 14.0);
+
+    REQUIRE_THROWS(load_npy<int, 3>(file.path));
+}
+
+TEST_CASE("npy round trip of a column-major array") {
+    temp_file file("col_major.npy");
+    array_base<layout::col_major<2>, storage::heap<int>> a(dshape<2> {4, 3});
+    assign(a, numbered(4, 3));
+
+    // Written in C order
+    save_npy(file.path, a);
+    npy_header header;
+    {
+        std::ifstream stream(file.path, std::ios::binary);
+        header = npy::read_header(stream);
+    }
+
+    REQUIRE_FALSE(header.fortran_order);
+    check_numbered(load_npy<int, 2>(file.path), 4, 3);
+}
+
+TEST_CASE("npy load and map data in Fortran order") {
+    temp_file file("fortran.npy");
+    index_t rows = 4;
+    index_t cols = 3;
+
+    // Same header length, so the data stays aligned
+    std::string header = npy::encode_header<int>(dshape<2> {rows, cols});
+    size_t pos = header.find("False");
+    header.replace(pos, 5, "True ");
+
+    std::string content = header;
+    for (index_t j = 0; j < cols; j++) {
+        for (index_t i = 0; i < rows; i++) {
+            int value = int(i * cols + j);
+            content.append(reinterpret_cast<const char*>(&value), sizeof(int));
+        }
+    }
+
+    write_file(file.path, content);
+
+    check_numbered(load_npy<int, 2>(file.path), rows, cols);
+    check_numbered(map_npy<const int, 2>(file.path), rows, cols);
+}
+
+TEST_CASE("npy data is mapped at a 64-byte aligned offset") {
+    temp_file file("aligned.npy");
+    save_npy(file.path, numbered(7, 9));
+
+    std::ifstream stream(file.path, std::ios::binary);
+    npy_header header = npy::read_header(stream);
+    REQUIRE(header.data_offset % 64 == 0);
+
+    auto mapped = map_npy<const int, 2>(file.path);
+    REQUIRE(reinterpret_cast<size_t>(mapped.data()) % 64 == 0);
+    check_numbered(mapped, 7, 9);
+
+    // The same file behind a 64-byte prefix
+    temp_file prefixed("prefixed.npy");
+    write_file(prefixed.path, std::string(64, 'x') + read_file(file.path));
+
+    auto shifted = map_npy<const int, 2>(
+        prefixed.path,
+        storage::mmap_advice::normal,
+        64);
+    REQUIRE(reinterpret_cast<size_t>(shifted.data()) % 64 == 0);
+    check_numbered(shifted, 7, 9);
+}
+
+TEST_CASE("npz entries are found with a valid checksum") {
+    temp_file file("archive.npz");
+
+    {
+        npz_writer writer(file.path);
+        writer.add("first", numbered(2, 3));
+        writer.add("second_entry", numbered(5, 1));
+        writer.close();
+    }
+
+    std::string content = read_file(file.path);
+    std::ifstream stream(file.path, std::ios::binary);
+
+    // Walk the local headers and compare each entry with `find_entry`
+    size_t pos = 0;
+    int entries = 0;
+
+    while (npy::read_le(&content[pos], 4) == 0x04034b50) {
+        uint32_t crc = uint32_t(npy::read_le(&content[pos + 14], 4));
+        size_t size = npy::read_le(&content[pos + 18], 4);
+        size_t name_length = npy::read_le(&content[pos + 26], 2);
+        size_t extra_length = npy::read_le(&content[pos + 28], 2);
+        std::string name = content.substr(pos + 30, name_length - 4);
+        size_t data = pos + 30 + name_length + extra_length;
+
+        REQUIRE(npy::find_entry(stream, name) == data);
+        REQUIRE(data % 64 == 0);
+        REQUIRE(npy::crc32(0, &content[data], size) == crc);
+
+        pos = data + size;
+        entries++;
+    }
+
+    REQUIRE(entries == 2);
+    check_numbered(load_npz<int, 2>(file.path, "first"), 2, 3);
+    check_numbered(map_npz<const int, 2>(file.path, "second_entry"), 5, 1);
+    REQUIRE_THROWS(npy::find_entry(stream, "missing"));
+}
+
+TEST_CASE("npy rejects corrupt files") {
+    temp_file file("corrupt.npy");
+    save_npy(file.path, numbered(3, 5));
+    std::string content = read_file(file.path);
+
+    SECTION("truncated header") {
+        write_file(file.path, content.substr(0, 20));
+        REQUIRE_THROWS(load_npy<int, 2>(file.path));
+        REQUIRE_THROWS(map_npy<const int, 2>(file.path));
+    }
+
+    SECTION("truncated data") {
+        write_file(file.path, content.substr(0, content.size() - 1));
+        REQUIRE_THROWS(load_npy<int, 2>(file.path));
+    }
+
+    SECTION("bad magic") {
+        content[1] = 'X';
+        write_file(file.path, content);
+        REQUIRE_THROWS(load_npy<int, 2>(file.path));
+    }
+
+    SECTION("missing shape") {
+        content.replace(content.find("'shape'"), 7, "'shope'");
+        write_file(file.path, content);
+        REQUIRE_THROWS(load_npy<int, 2>(file.path));
+    }
+
+    SECTION("unsupported dtype") {
+        content.replace(content.find("'descr'") + 11, 1, "c");
+        write_file(file.path, content);
+        REQUIRE_THROWS(load_npy<int, 2>(file.path));
+    }
+
+    SECTION("not an archive") {
+        std::ifstream stream(file.path, std::ios::binary);
+        REQUIRE_THROWS(npy::find_entry(stream, "a"));
+    }
+}
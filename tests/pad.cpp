@@ -0,0 +1,123 @@
+#include "capybara/array.h"
+#include "capybara/eval.h"
+#include "capybara/pad.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+static array<int, 1> numbered(index_t n) {
+    array<int, 1> result(dshape<1> {n});
+
+    for (index_t i = 0; i < n; i++) {
+        result.data()[i] = 10 + int(i);
+    }
+
+    return result;
+}
+
+// Mirrors `i` at the ends of `[0, n)` until it lies inside, as in NumPy's
+// "reflect" mode.
+static index_t reflected(index_t i, index_t n) {
+    if (n == 1) {
+        return 0;
+    }
+
+    while (i < 0 || i >= n) {
+        i = i < 0 ? -i : 2 * (n - 1) - i;
+    }
+
+    return i;
+}
+
+static index_t clamped(index_t i, index_t n) {
+    return i < 0 ? 0 : i >= n ? n - 1 : i;
+}
+
+TEST_CASE("pad wider than the axis") {
+    for (index_t n : {1, 2, 3, 4}) {
+        array<int, 1> a = numbered(n);
+        index_t before = 2 * n + 1;
+        index_t after = 3 * n + 2;
+        index_t length = before + n + after;
+
+        array<int, 1> constant =
+            evaluate(pad(a, {before}, {after}, pad_mode::constant, -1));
+        array<int, 1> edge =
+            evaluate(pad(a, {before}, {after}, pad_mode::edge));
+        array<int, 1> reflect =
+            evaluate(pad(a, {before}, {after}, pad_mode::reflect));
+
+        REQUIRE(constant.dimension(0) == length);
+        REQUIRE(edge.dimension(0) == length);
+        REQUIRE(reflect.dimension(0) == length);
+
+        for (index_t i = 0; i < length; i++) {
+            index_t k = i - before;
+            bool inside = k >= 0 && k < n;
+
+            REQUIRE(constant.data()[i] == (inside ? 10 + int(k) : -1));
+            REQUIRE(edge.data()[i] == 10 + int(clamped(k, n)));
+            REQUIRE(reflect.data()[i] == 10 + int(reflected(k, n)));
+        }
+    }
+}
+
+TEST_CASE("reflect has period 2(n-1)") {
+    array<int, 1> a = numbered(4);
+    array<int, 1> result = evaluate(pad(a, {0}, {12}, pad_mode::reflect));
+
+    // 10 11 12 13 12 11 | 10 11 12 13 12 11 | 10 11 12 13
+    for (index_t i = 0; i < 16; i++) {
+        REQUIRE(result.data()[i] == 10 + int(reflected(i % 6, 4)));
+    }
+}
+
+TEST_CASE("pad both axes, including the corners") {
+    array<int, 2> a(dshape<2> {2, 3});
+    for (index_t i = 0; i < 6; i++) {
+        a.data()[i] = int(i);
+    }
+
+    for (pad_mode mode :
+         {pad_mode::constant, pad_mode::edge, pad_mode::reflect}) {
+        array<int, 2> result = evaluate(pad(a, {3, 4}, mode, -1));
+        REQUIRE(result.shape() == dshape<2> {8, 11});
+
+        for (index_t i = 0; i < 8; i++) {
+            for (index_t j = 0; j < 11; j++) {
+                index_t r = i - 3;
+                index_t c = j - 4;
+                int expected;
+
+                if (mode == pad_mode::constant) {
+                    bool inside = r >= 0 && r < 2 && c >= 0 && c < 3;
+                    expected = inside ? int(r * 3 + c) : -1;
+                } else if (mode == pad_mode::edge) {
+                    expected = int(clamped(r, 2) * 3 + clamped(c, 3));
+                } else {
+                    expected = int(reflected(r, 2) * 3 + reflected(c, 3));
+                }
+
+                REQUIRE(result.data()[i * 11 + j] == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("pad an axis of length one") {
+    array<int, 2> a(dshape<2> {1, 2});
+    a.data()[0] = 7;
+    a.data()[1] = 8;
+
+    array<int, 2> edge = evaluate(pad(a, {2, 0}, pad_mode::edge));
+    array<int, 2> reflect = evaluate(pad(a, {2, 0}, pad_mode::reflect));
+    array<int, 2> constant = evaluate(pad(a, {2, 0}, pad_mode::constant, 0));
+
+    for (index_t i = 0; i < 5; i++) {
+        REQUIRE(edge.data()[i * 2] == 7);
+        REQUIRE(edge.data()[i * 2 + 1] == 8);
+        REQUIRE(reflect.data()[i * 2] == 7);
+        REQUIRE(reflect.data()[i * 2 + 1] == 8);
+        REQUIRE(constant.data()[i * 2] == (i == 2 ? 7 : 0));
+    }
+}
@@ -0,0 +1,273 @@
+#include "capybara/array.h"
+#include "capybara/eval.h"
+#include "capybara/ops.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+static array<int, 2> numbered(index_t rows, index_t cols) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = int(i);
+    }
+
+    return result;
+}
+
+// Forwards to the heap and counts what passes through.
+struct counting_resource: storage::memory_resource {
+    void* allocate(size_t bytes, size_t align) override {
+        allocations++;
+        allocated += bytes;
+        return storage::heap_resource::instance().allocate(bytes, align);
+    }
+
+    void deallocate(void* ptr, size_t bytes, size_t align) override {
+        deallocations++;
+        storage::heap_resource::instance().deallocate(ptr, bytes, align);
+    }
+
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t allocated = 0;
+};
+
+TEST_CASE("evaluate_temporary allocates from the scoped resource") {
+    array<int, 2> a = numbered(3, 4);
+    array<int, 2> b = numbered(3, 4);
+    counting_resource resource;
+
+    {
+        storage::scoped_resource scope(resource);
+        auto t = evaluate_temporary(a + b);
+
+        REQUIRE(&t.storage().resource() == &resource);
+        REQUIRE(resource.allocations == 1);
+        REQUIRE(resource.allocated == 12 * sizeof(int));
+
+        for (index_t i = 0; i < 12; i++) {
+            REQUIRE(t.data()[i] == 2 * int(i));
+        }
+    }
+
+    REQUIRE(resource.deallocations == 1);
+
+    auto t = evaluate_temporary(a + b);
+    REQUIRE(&t.storage().resource() == &storage::heap_resource::instance());
+    REQUIRE(resource.allocations == 1);
+}
+
+TEST_CASE("extend takes its temporary from the scoped resource") {
+    array<int, 2> a = numbered(2, 3);
+    counting_resource resource;
+    storage::scoped_resource scope(resource);
+
+    // The rows move to a new heap buffer, so `a` is copied to a temporary
+    // first. Only that temporary comes from `resource`.
+    a.extend(a);
+
+    REQUIRE(resource.allocations == 1);
+    REQUIRE(resource.allocated == 6 * sizeof(int));
+    REQUIRE(resource.deallocations == 1);
+    REQUIRE(a.shape() == dshape<2> {4, 3});
+
+    for (index_t i = 0; i < 12; i++) {
+        REQUIRE(a.data()[i] == int(i % 6));
+    }
+}
+
+TEST_CASE("arena scope releases its temporaries") {
+    array<int, 2> a = numbered(8, 8);
+    storage::monotonic_arena arena(1024);
+    const int* first;
+
+    {
+        storage::arena_scope scope(arena);
+        auto t = evaluate_temporary(a + a);
+        auto u = evaluate_temporary(t + a);
+        first = t.data();
+
+        REQUIRE(u.data() != first);
+        REQUIRE(u.data()[63] == 3 * 63);
+    }
+
+    storage::arena_scope scope(arena);
+    auto t = evaluate_temporary(a + a);
+    REQUIRE(t.data() == first);
+}
+
+TEST_CASE("pool arena recycles temporaries of the same size class") {
+    array<int, 2> a = numbered(5, 5);
+    storage::pool_arena pool;
+    storage::scoped_resource scope(pool);
+    const int* first;
+
+    {
+        auto t = evaluate_temporary(a + a);
+        first = t.data();
+    }
+
+    auto t = evaluate_temporary(numbered(4, 6) + numbered(4, 6));
+    REQUIRE(t.data() == first);
+    REQUIRE(t.data()[23] == 46);
+}
+
+TEST_CASE("small storage keeps its elements when it spills and shrinks") {
+    storage::small<int, 4> s;
+    s.resize(3);
+    REQUIRE(s.is_inline());
+
+    for (int i = 0; i < 3; i++) {
+        s.data()[i] = 10 + i;
+    }
+
+    s.resize(4);
+    REQUIRE(s.is_inline());
+    s.data()[3] = 13;
+
+    s.resize(9);
+    REQUIRE_FALSE(s.is_inline());
+
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(s.data()[i] == 10 + i);
+    }
+
+    for (int i = 4; i < 9; i++) {
+        s.data()[i] = 10 + i;
+    }
+
+    s.resize(12);
+    REQUIRE_FALSE(s.is_inline());
+
+    for (int i = 0; i < 9; i++) {
+        REQUIRE(s.data()[i] == 10 + i);
+    }
+
+    s.resize(2);
+    REQUIRE(s.is_inline());
+    REQUIRE(s.data()[0] == 10);
+    REQUIRE(s.data()[1] == 11);
+
+    s.resize(0);
+    REQUIRE(s.is_inline());
+}
+
+TEST_CASE("small array evaluates inline and spilled") {
+    using small_array =
+        array_base<layout::row_major<2>, storage::small<int, 8>>;
+
+    for (index_t rows : {1, 2, 5}) {
+        array<int, 2> source = numbered(rows, 4);
+        small_array a(dshape<2> {rows, 4});
+        assign(a, source);
+
+        REQUIRE(a.storage().is_inline() == (rows * 4 <= 8));
+        array<int, 2> copy = evaluate(a);
+
+        for (index_t i = 0; i < rows * 4; i++) {
+            REQUIRE(copy.data()[i] == int(i));
+        }
+    }
+}
+
+using shared_array = array_base<layout::row_major<2>, storage::shared<int>>;
+
+static const int* shared_data(const shared_array& a) {
+    return a.data();
+}
+
+TEST_CASE("shared array copies on write") {
+    shared_array a(dshape<2> {3, 4});
+    assign(a, numbered(3, 4));
+
+    shared_array b = a;
+    REQUIRE(a.storage().use_count() == 2);
+    REQUIRE(shared_data(a) == shared_data(b));
+
+    // Reading both copies in an expression does not copy the buffer.
+    array<int, 2> sum = evaluate(a + b);
+    REQUIRE(shared_data(a) == shared_data(b));
+    REQUIRE(sum.data()[11] == 22);
+
+    b.data()[0] = 100;
+    REQUIRE(shared_data(a) != shared_data(b));
+    REQUIRE(a.storage().unique());
+    REQUIRE(b.storage().unique());
+    REQUIRE(shared_data(a)[0] == 0);
+    REQUIRE(shared_data(b)[0] == 100);
+
+    shared_array c = a;
+    assign(c, numbered(3, 4) + numbered(3, 4));
+    REQUIRE(shared_data(a) != shared_data(c));
+    REQUIRE(shared_data(c)[5] == 10);
+
+    for (index_t i = 0; i < 12; i++) {
+        REQUIRE(shared_data(a)[i] == int(i));
+    }
+}
+
+TEST_CASE("shared array is unique once its copies are gone") {
+    shared_array a(dshape<2> {2, 2});
+    const int* data = shared_data(a);
+
+    {
+        shared_array b = a;
+        shared_array c = b;
+        REQUIRE(a.storage().use_count() == 3);
+        REQUIRE_FALSE(a.storage().unique());
+    }
+
+    REQUIRE(a.storage().unique());
+    a.data()[3] = 7;
+    REQUIRE(shared_data(a) == data);
+}
+
+TEST_CASE("evaluate reuses the buffer of a moved array") {
+    array<int, 2> a = numbered(3, 4);
+    array<int, 2> b = numbered(3, 4);
+    const int* data = a.data();
+
+    array<int, 2> sum = evaluate(std::move(a) + b);
+    REQUIRE(sum.data() == data);
+
+    for (index_t i = 0; i < 12; i++) {
+        REQUIRE(sum.data()[i] == 2 * int(i));
+    }
+
+    array<int, 2> c = numbered(3, 4);
+    data = c.data();
+
+    array<int, 2> twice = evaluate(b + std::move(c));
+    REQUIRE(twice.data() == data);
+    REQUIRE(twice.data()[11] == 22);
+}
+
+TEST_CASE("evaluate does not reuse shared or broadcast buffers") {
+    shared_array a(dshape<2> {3, 4});
+    assign(a, numbered(3, 4));
+    shared_array copy = a;
+
+    array<int, 2> sum = evaluate(std::move(a) + numbered(3, 4));
+    REQUIRE(sum.data() != shared_data(copy));
+    REQUIRE(sum.data()[11] == 22);
+
+    for (index_t i = 0; i < 12; i++) {
+        REQUIRE(shared_data(copy)[i] == int(i));
+    }
+
+    // The row is broadcast to the shape of the result, so it is too small.
+    array<int, 1> row(dshape<1> {4});
+    const int* data = row.data();
+
+    for (index_t i = 0; i < 4; i++) {
+        row.data()[i] = int(i);
+    }
+
+    array<int, 2> broadcast = evaluate(std::move(row) + numbered(3, 4));
+    REQUIRE(broadcast.data() != data);
+
+    for (index_t i = 0; i < 12; i++) {
+        REQUIRE(broadcast.data()[i] == int(i + i % 4));
+    }
+}
@@ -0,0 +1,222 @@
+#include <cstdio>
+#include <fstream>
+
+#include "capybara/ops.h"
+#include "capybara/stream.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+namespace {
+// File in the working directory that is removed at the end of the test.
+struct temp_file {
+    explicit temp_file(const std::string& name) :
+        path("stream_test_" + name) {}
+
+    ~temp_file() {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+}  // namespace
+
+static array<int, 2> numbered(index_t rows, index_t cols, int scale) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = scale * int(i);
+    }
+
+    return result;
+}
+
+static chunked_file<int, 2> make_chunked(
+    const temp_file& file,
+    const array<int, 2>& values,
+    index_t chunk_rows) {
+    auto result = chunked_file<int, 2>::create(
+        file.path,
+        values.shape(),
+        dshape<2> {chunk_rows, 3},
+        chunk_codec::shuffle_rle);
+    result.write(values);
+    return result;
+}
+
+static void check_equal(const array<int, 2>& lhs, const array<int, 2>& rhs) {
+    REQUIRE(lhs.shape() == rhs.shape());
+
+    for (index_t i = 0; i < index_t(lhs.size()); i++) {
+        REQUIRE(lhs.data()[i] == rhs.data()[i]);
+    }
+}
+
+static auto sum = [](const auto& a, const auto& b) { return a + b; };
+
+TEST_CASE("stream chunked files into a chunked file") {
+    temp_file x_file("x");
+    temp_file y_file("y");
+    temp_file out_file("out");
+    auto x = make_chunked(x_file, numbered(23, 7, 1), 4);
+    auto y = make_chunked(y_file, numbered(23, 7, 2), 3);
+
+    for (index_t block_rows : {5, 7, 23, 40}) {
+        auto out = chunked_file<int, 2>::create(
+            out_file.path,
+            dshape<2> {23, 7},
+            dshape<2> {4, 3},
+            chunk_codec::delta_bitpack);
+
+        stream_options options;
+        options.block_rows = block_rows;
+        options.prefetch = 2;
+        options.threads = 2;
+
+        evaluate_streaming(out, options, sum, x, y);
+        check_equal(out.read(), numbered(23, 7, 3));
+    }
+}
+
+TEST_CASE("stream an in-place update of a chunked file") {
+    // Blocks of 8 rows are aligned to the chunks of 4 rows and are read
+    // ahead; blocks of 6 rows share chunks and are read one at a time.
+    for (index_t block_rows : {8, 6}) {
+        for (size_t prefetch : {1, 2}) {
+            temp_file file("in_place");
+            auto x = make_chunked(file, numbered(30, 5, 1), 4);
+
+            stream_options options;
+            options.block_rows = block_rows;
+            options.prefetch = prefetch;
+
+            evaluate_streaming(x, options, sum, x, x);
+            check_equal(x.read(), numbered(30, 5, 2));
+        }
+    }
+}
+
+TEST_CASE("stream rethrows errors of a background read") {
+    temp_file file("corrupt");
+    auto x = make_chunked(file, numbered(20, 3, 1), 2);
+    array<int, 2> out(dshape<2> {20, 3});
+
+    // Point the index entry of chunk 7 (rows 14 and 15) far past the end
+    // of the file.
+    {
+        std::fstream stream(
+            file.path,
+            std::ios::binary | std::ios::in | std::ios::out);
+        std::string entry;
+        npy::write_le(entry, uint64_t(1) << 40, 8);
+        stream.seekp(chunked::header_size + 2 * 2 * 8 + 7 * 16);
+        stream << entry;
+    }
+
+    auto corrupt = chunked_file<int, 2>::open(file.path);
+    auto same = [](const auto& a) { return a + a; };
+
+    for (size_t prefetch : {0, 1, 3}) {
+        stream_options options;
+        options.block_rows = 3;
+        options.prefetch = prefetch;
+
+        REQUIRE_THROWS(evaluate_streaming(out, options, same, corrupt));
+    }
+}
+
+TEST_CASE("stream rethrows errors of the evaluation") {
+    temp_file file("failing");
+    auto x = make_chunked(file, numbered(20, 3, 1), 2);
+    array<int, 2> out(dshape<2> {20, 3});
+    int calls = 0;
+
+    auto failing = [&calls](const auto& a) {
+        if (++calls == 3) {
+            throw std::runtime_error("failed");
+        }
+
+        return a + a;
+    };
+
+    stream_options options;
+    options.block_rows = 2;
+    options.prefetch = 2;
+
+    REQUIRE_THROWS(evaluate_streaming(out, options, failing, x));
+    REQUIRE(calls == 3);
+}
+
+TEST_CASE("stream broadcasts operands of a lower rank") {
+    temp_file file("broadcast");
+    auto x = make_chunked(file, numbered(11, 4, 1), 3);
+    array<int, 2> y = numbered(11, 4, 5);
+    array<int, 1> row(dshape<1> {4});
+    array<int, 2> out(dshape<2> {11, 4});
+
+    for (index_t j = 0; j < 4; j++) {
+        row.data()[j] = 100 * int(j);
+    }
+
+    auto combine = [](const auto& a, const auto& r, const auto& b) {
+        return a + r + b;
+    };
+
+    stream_options options;
+    options.block_rows = 4;
+    options.prefetch = 2;
+
+    evaluate_streaming(out, options, combine, x, row, y);
+
+    for (index_t i = 0; i < 11; i++) {
+        for (index_t j = 0; j < 4; j++) {
+            int expected = 6 * int(i * 4 + j) + 100 * int(j);
+            REQUIRE(out.data()[i * 4 + j] == expected);
+        }
+    }
+}
+
+TEST_CASE("stream statistics count blocks and bytes read") {
+    temp_file x_file("stats_x");
+    temp_file y_file("stats_y");
+    auto x = make_chunked(x_file, numbered(23, 7, 1), 4);
+    auto y = make_chunked(y_file, numbered(23, 7, 2), 3);
+    array<int, 2> plain = numbered(23, 7, 4);
+    array<int, 2> out(dshape<2> {23, 7});
+    size_t source_bytes = 23 * 7 * sizeof(int);
+
+    // Prefetch 0 reads every block just before it is used, the others
+    // read ahead on a background thread.
+    for (size_t prefetch : {0, 1, 2}) {
+        for (index_t block_rows : {1, 5, 8, 23, 30}) {
+            stream_options options;
+            options.block_rows = block_rows;
+            options.prefetch = prefetch;
+            size_t blocks = size_t((23 + block_rows - 1) / block_rows);
+
+            stream_stats stats = evaluate_streaming(out, options, sum, x, y);
+            REQUIRE(stats.blocks == blocks);
+            REQUIRE(stats.bytes_read == 2 * source_bytes);
+
+            // Arrays are sliced, not read
+            stats = evaluate_streaming(out, options, sum, x, plain);
+            REQUIRE(stats.blocks == blocks);
+            REQUIRE(stats.bytes_read == source_bytes);
+        }
+    }
+
+    stream_options options;
+    options.block_rows = 6;
+    options.prefetch = 2;
+
+    stream_stats stats = evaluate_streaming(out, options, sum, plain, plain);
+    REQUIRE(stats.blocks == 4);
+    REQUIRE(stats.bytes_read == 0);
+    check_equal(out, numbered(23, 7, 8));
+
+    // In place with blocks that share chunks, so nothing is read ahead
+    stats = evaluate_streaming(x, options, sum, x, y);
+    REQUIRE(stats.blocks == 4);
+    REQUIRE(stats.bytes_read == 2 * source_bytes);
+    check_equal(x.read(), numbered(23, 7, 3));
+}
@@ -0,0 +1,113 @@
+#include "capybara/array.h"
+#include "capybara/eval.h"
+#include "capybara/ring.h"
+#include "capybara/wrap.h"
+#include "catch.hpp"
+
+using namespace capybara;
+
+static array<int, 1> numbered(index_t n) {
+    array<int, 1> result(dshape<1> {n});
+
+    for (index_t i = 0; i < n; i++) {
+        result.data()[i] = int(i);
+    }
+
+    return result;
+}
+
+static array<int, 2> numbered(index_t rows, index_t cols) {
+    array<int, 2> result(dshape<2> {rows, cols});
+
+    for (index_t i = 0; i < rows * cols; i++) {
+        result.data()[i] = int(i);
+    }
+
+    return result;
+}
+
+static index_t modulo(index_t i, index_t n) {
+    return (i % n + n) % n;
+}
+
+TEST_CASE("roll matches index arithmetic") {
+    array<int, 1> a = numbered(5);
+
+    for (index_t shift : {0, 1, 3, -1, -2, 5, 7, -12, 23}) {
+        array<int, 1> result = evaluate(roll(a, shift));
+
+        REQUIRE(result.dimension(0) == 5);
+        for (index_t i = 0; i < 5; i++) {
+            REQUIRE(result.data()[i] == int(modulo(i - shift, 5)));
+        }
+    }
+}
+
+TEST_CASE("roll along the second axis") {
+    array<int, 2> a = numbered(3, 4);
+    array<int, 2> result = evaluate(roll(a, -6, 1));
+
+    for (index_t i = 0; i < 3; i++) {
+        for (index_t j = 0; j < 4; j++) {
+            int expected = int(i * 4 + modulo(j + 6, 4));
+            REQUIRE(result.data()[i * 4 + j] == expected);
+        }
+    }
+}
+
+TEST_CASE("tile matches index arithmetic") {
+    array<int, 2> a = numbered(2, 3);
+    array<int, 2> result = evaluate(tile(a, {3, 2}));
+
+    REQUIRE(result.shape() == dshape<2> {6, 6});
+    for (index_t i = 0; i < 6; i++) {
+        for (index_t j = 0; j < 6; j++) {
+            REQUIRE(result.data()[i * 6 + j] == int((i % 2) * 3 + j % 3));
+        }
+    }
+}
+
+TEST_CASE("tile of a rolled expression") {
+    array<int, 1> a = numbered(4);
+    array<int, 1> result = evaluate(tile(roll(a, 1), {3}));
+
+    REQUIRE(result.dimension(0) == 12);
+    for (index_t i = 0; i < 12; i++) {
+        REQUIRE(result.data()[i] == int(modulo(i % 4 - 1, 4)));
+    }
+}
+
+TEST_CASE("assign splits runs at the segment boundaries of a ring") {
+    ring_array<int, 2> ring(layout::ring<2>(dshape<2> {0, 3}, 5));
+    array<int, 1> zero(dshape<1> {3});
+
+    for (index_t j = 0; j < 3; j++) {
+        zero.data()[j] = 0;
+    }
+
+    // Slot of the oldest row ends up in the middle of the buffer
+    for (int i = 0; i < 8; i++) {
+        push(ring, zero);
+    }
+
+    REQUIRE(ring.layout().head() == 3);
+
+    // Runs along axis 0 break where the slots wrap around, in both the
+    // destination and a rolled source
+    array<int, 2> source = numbered(5, 3);
+    assign(ring, roll(source, 2, 0));
+
+    array<int, 2> result = evaluate(ring);
+    for (index_t i = 0; i < 5; i++) {
+        for (index_t j = 0; j < 3; j++) {
+            int expected = int(modulo(i - 2, 5) * 3 + j);
+            REQUIRE(result.data()[i * 3 + j] == expected);
+        }
+    }
+
+    // The rows themselves are stored starting from the head slot
+    for (index_t i = 0; i < 5; i++) {
+        index_t slot = (3 + i) % 5;
+        REQUIRE(ring.data()[slot * 3] == int(modulo(i - 2, 5) * 3));
+    }
+}